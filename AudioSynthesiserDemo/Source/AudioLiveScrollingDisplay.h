@@ -1,76 +1,76 @@
-/*
-  ==============================================================================
-
-   This file is part of the JUCE examples.
-   Copyright (c) 2022 - Raw Material Software Limited
-
-   The code included in this file is provided under the terms of the ISC license
-   http://www.isc.org/downloads/software-support-policy/isc-license. Permission
-   To use, copy, modify, and/or distribute this software for any purpose with or
-   without fee is hereby granted provided that the above copyright notice and
-   this permission notice appear in all copies.
-
-   THE SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES,
-   WHETHER EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR
-   PURPOSE, ARE DISCLAIMED.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-
-//==============================================================================
-/* This component scrolls a continuous waveform showing the audio that's
-   coming into whatever audio inputs this object is connected to.
-*/
-class LiveScrollingAudioDisplay final : public AudioVisualiserComponent,
-                                        public AudioIODeviceCallback
-{
-public:
-    LiveScrollingAudioDisplay()  : AudioVisualiserComponent (1)
-    {
-        setSamplesPerBlock (8);
-        setBufferSize (64);
-    }
-
-    //==============================================================================
-    void audioDeviceAboutToStart (AudioIODevice*) override
-    {
-        clear();
-    }
-
-    void audioDeviceStopped() override
-    {
-        clear();
-    }
-
-    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
-                                           float* const* outputChannelData, int numOutputChannels,
-                                           int numberOfSamples, const AudioIODeviceCallbackContext& context) override
-    {
-        ignoreUnused (context);
-
-        for (int i = 0; i < numberOfSamples; ++i)
-        {
-            float inputSample = 0;
-
-            for (int chan = 0; chan < numInputChannels; ++chan)
-                if (const float* inputChannel = inputChannelData[chan])
-                    inputSample += inputChannel[i];  // find the sum of all the channels
-
-            //inputSample *= 10.0f; // boost the level to make it more easily visible.
-            //if (i % 8 == 0)
-            {
-                pushSample (&inputSample, 1);
-            }
-        }
-
-        // We need to clear the output buffers before returning, in case they're full of junk..
-        for (int j = 0; j < numOutputChannels; ++j)
-            if (float* outputChannel = outputChannelData[j])
-                zeromem (outputChannel, (size_t) numberOfSamples * sizeof (float));
-    }
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LiveScrollingAudioDisplay)
-};
+/*
+  ==============================================================================
+
+   This file is part of the JUCE examples.
+   Copyright (c) 2022 - Raw Material Software Limited
+
+   The code included in this file is provided under the terms of the ISC license
+   http://www.isc.org/downloads/software-support-policy/isc-license. Permission
+   To use, copy, modify, and/or distribute this software for any purpose with or
+   without fee is hereby granted provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES,
+   WHETHER EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR
+   PURPOSE, ARE DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+
+//==============================================================================
+/* This component scrolls a continuous waveform showing the audio that's
+   coming into whatever audio inputs this object is connected to.
+*/
+class LiveScrollingAudioDisplay final : public AudioVisualiserComponent,
+                                        public AudioIODeviceCallback
+{
+public:
+    LiveScrollingAudioDisplay()  : AudioVisualiserComponent (1)
+    {
+        setSamplesPerBlock (8);
+        setBufferSize (64);
+    }
+
+    //==============================================================================
+    void audioDeviceAboutToStart (AudioIODevice*) override
+    {
+        clear();
+    }
+
+    void audioDeviceStopped() override
+    {
+        clear();
+    }
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                           float* const* outputChannelData, int numOutputChannels,
+                                           int numberOfSamples, const AudioIODeviceCallbackContext& context) override
+    {
+        ignoreUnused (context);
+
+        for (int i = 0; i < numberOfSamples; ++i)
+        {
+            float inputSample = 0;
+
+            for (int chan = 0; chan < numInputChannels; ++chan)
+                if (const float* inputChannel = inputChannelData[chan])
+                    inputSample += inputChannel[i];  // find the sum of all the channels
+
+            //inputSample *= 10.0f; // boost the level to make it more easily visible.
+            //if (i % 8 == 0)
+            {
+                pushSample (&inputSample, 1);
+            }
+        }
+
+        // We need to clear the output buffers before returning, in case they're full of junk..
+        for (int j = 0; j < numOutputChannels; ++j)
+            if (float* outputChannel = outputChannelData[j])
+                zeromem (outputChannel, (size_t) numberOfSamples * sizeof (float));
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LiveScrollingAudioDisplay)
+};
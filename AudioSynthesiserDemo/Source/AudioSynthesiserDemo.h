@@ -1,440 +1,1977 @@
-/*
-  ==============================================================================
-
-   This file is part of the JUCE examples.
-   Copyright (c) 2022 - Raw Material Software Limited
-
-   The code included in this file is provided under the terms of the ISC license
-   http://www.isc.org/downloads/software-support-policy/isc-license. Permission
-   To use, copy, modify, and/or distribute this software for any purpose with or
-   without fee is hereby granted provided that the above copyright notice and
-   this permission notice appear in all copies.
-
-   THE SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES,
-   WHETHER EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR
-   PURPOSE, ARE DISCLAIMED.
-
-  ==============================================================================
-*/
-
-/*******************************************************************************
- The block below describes the properties of this PIP. A PIP is a short snippet
- of code that can be read by the Projucer and used to generate a JUCE project.
-
- BEGIN_JUCE_PIP_METADATA
-
- name:             AudioSynthesiserDemo
- version:          1.0.0
- vendor:           JUCE
- website:          http://juce.com
- description:      Simple synthesiser application.
-
- dependencies:     juce_audio_basics, juce_audio_devices, juce_audio_formats,
-                   juce_audio_processors, juce_audio_utils, juce_core,
-                   juce_data_structures, juce_events, juce_graphics,
-                   juce_gui_basics, juce_gui_extra
- exporters:        xcode_mac, vs2022, linux_make, androidstudio, xcode_iphone
-
- moduleFlags:      JUCE_STRICT_REFCOUNTEDPOINTER=1
-
- type:             Component
- mainClass:        AudioSynthesiserDemo
-
- useLocalCopy:     1
-
- END_JUCE_PIP_METADATA
-
-*******************************************************************************/
-
-#pragma once
-
-#include "DemoUtilities.h"
-#include "AudioLiveScrollingDisplay.h"
-
-
-typedef juce::AudioProcessorValueTreeState::SliderAttachment SliderAttachment;
-typedef juce::AudioProcessorValueTreeState::ButtonAttachment ButtonAttachment;
-
-
-//==============================================================================
-/** Our demo synth sound is just a basic sine wave.. */
-struct SineWaveSound final : public SynthesiserSound
-{
-    bool appliesToNote (int /*midiNoteNumber*/) override    { return true; }
-    bool appliesToChannel (int /*midiChannel*/) override    { return true; }
-};
-
-//==============================================================================
-/** Our demo synth voice just plays a sine wave.. */
-struct SineWaveVoice final : public SynthesiserVoice
-{
-    SineWaveVoice(LEAF * leaf) : leaf(leaf)
-    {
-        for (int i = 0; i < numModes; i++)
-        {
-            tCycle_init(&mySine[i], leaf);
-            outputWeights[i] = sin((i+1.0f) * pickupPos);
-        }
-    }
-    
-    void setInitialAmplitudes()
-    {
-        for (int i = 0; i < numModes; i++)
-        {
-            int n = i + 1;
-            double denom = ((n * n) * pluckPos) * (PI - pluckPos);
-            amplitudes[i] = 2.0 * sin(pluckPos * n) / denom;
-            if ((amplitudes[i] > 1.0f) || (isnan(amplitudes[i])))
-            {
-                DBG("HELP ME:");
-            }
-        }
-    }
-    
-    void changePickupPos()
-    {
-        for (int i = 0; i < numModes; i++)
-        {
-            outputWeights[i] = sin((i+1.0f) * pickupPos);
-        }
-    }
-    bool canPlaySound (SynthesiserSound* sound) override
-    {
-        return dynamic_cast<SineWaveSound*> (sound) != nullptr;
-    }
-
-    void startNote (int midiNoteNumber, float velocity,
-                    SynthesiserSound*, int /*currentPitchWheelPosition*/) override
-    {
-        if (!playing)
-        {
-            auto cyclesPerSecond = MidiMessage::getMidiNoteInHertz (midiNoteNumber);
-            for (int i = 0; i < numModes; i++)
-            {
-                int myMode = i + 1;
-                float myModeSquared = myMode * myMode;
-                float sig = decay + (decayHighFreq * myModeSquared);
-                float w0 = myMode * sqrtf(1.0f + (sliderVal * sliderVal) * myModeSquared);
-                float w = w0 * sqrtf(1.0f - ((sig * sig) / (w0 * w0)));
-                tCycle_setFreq(&mySine[i], cyclesPerSecond * w);
-                setInitialAmplitudes();
-                
-            }
-            playing = 1;
-            masterAmplitude = 0.7f;
-            DBG("newnote");
-            
-        }
-
-    }
-
-    void stopNote (float /*velocity*/, bool allowTailOff) override
-    {
-        
-        if (playing)
-        {
-            masterAmplitude = 0.0f;
-            playing = 0;
-            DBG("stopppped");
-        }
-    }
-
-    void pitchWheelMoved (int /*newValue*/) override                              {}
-    void controllerMoved (int /*controllerNumber*/, int /*newValue*/) override    {}
-
-    void renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
-    {
-        while (--numSamples >= 0)
-        {
-            auto currentSample = 0.0f;
-            for (int j = 0; j < numModes; j++)
-            {
-                int myMode = j + 1;
-                float myModeSquared = myMode * myMode;
-                float sig = decay + (decayHighFreq * myModeSquared);
-                currentSample += tCycle_tick(&mySine[j]) * amplitudes[j] * outputWeights[j] * masterAmplitude;
-                double preExp = -sig * leaf->invSampleRate * mySine[j]->freq;
-                double multiplier = exp(preExp);
-                //double multiplier = 1.0f + preExp;
-                //multiplier = 0.999f;
-                amplitudes[j] = amplitudes[j] * multiplier;
-            }
-
-            for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                outputBuffer.addSample (i, startSample, currentSample);
-            ++startSample;
-        }
-        //DBG(amplitudes[0]);
-    }
-
-    using SynthesiserVoice::renderNextBlock;
-    float sliderVal = 0.0f;
-    float pluckPos = 0.2f;
-    float pickupPos = 0.3f;
-private:
-    float masterAmplitude = 0.0f;
-
-    const static int numModes = 50;
-    double amplitudes[numModes] = {0.0f};
-    double outputWeights[numModes] = {0.0f};
-    const float decay = 0.001f;
-    const float decayHighFreq = 0.001f;
-
-    tCycle mySine[numModes];
-    int playing = 0;
-    LEAF *leaf;
-
-};
-
-class LabeledSlider : public GroupComponent
-{
-public:
-    LabeledSlider (const String& name)
-    {
-        setText (name);
-        setTextLabelPosition (Justification::centredTop);
-        addAndMakeVisible (slider);
-    }
-    
-    void resized() override
-    {
-        slider.setBounds (getLocalBounds().reduced (.5));
-    }
-    
-    Slider slider { Slider::RotaryHorizontalVerticalDrag, Slider::TextBoxBelow };
-};
-//==============================================================================
-// This is an audio source that streams the output of our demo synth.
-struct SynthAudioSource final : public AudioSource, public juce::Slider::Listener
-{
-
-    SynthAudioSource (MidiKeyboardState& keyState)  : keyboardState (keyState)
-    {
-        LEAF_init(&leaf, 44100, leafMemory, 32, []() {return (float)rand() / RAND_MAX; });
-        // Add some voices to our synth, to play the sounds..
-        for (auto i = 0; i < 1; ++i)
-        {
-            synth.addVoice (new SineWaveVoice(&leaf));   // These voices will play our custom sine-wave sounds..
-        }
-
-        // ..and add a sound for them to play...
-        setUsingSineWaveSound();
-    }
-
-    void setUsingSineWaveSound()
-    {
-        synth.clearSounds();
-        synth.addSound (new SineWaveSound());
-    }
-
-    void sliderValueChanged(juce::Slider* slider) override
-    {
-        for (auto i = 0; i < 1; ++i)
-        {
-            SineWaveVoice * voice = (SineWaveVoice*)synth.getVoice(i);
-            
-            if (slider->getComponentID() == "stiffness")
-            {
-                voice->sliderVal = slider->getValue();
-            }
-            if (slider->getComponentID() == "pluck pos")
-            {
-                voice->pluckPos = slider->getValue();
-            }
-            if (slider->getComponentID() == "pickup pos")
-            {
-                voice->pickupPos = slider->getValue();
-                voice->changePickupPos();
-            }
-        }
-    }
-
-    void prepareToPlay (int /*samplesPerBlockExpected*/, double sampleRate) override
-    {
-        midiCollector.reset (sampleRate);
-        LEAF_setSampleRate(&leaf, sampleRate);
-        synth.setCurrentPlaybackSampleRate (sampleRate);
-    }
-
-    void releaseResources() override {}
-
-    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override
-    {
-        // the synth always adds its output to the audio buffer, so we have to clear it
-        // first..
-        bufferToFill.clearActiveBufferRegion();
-
-        // fill a midi buffer with incoming messages from the midi input.
-        MidiBuffer incomingMidi;
-        midiCollector.removeNextBlockOfMessages (incomingMidi, bufferToFill.numSamples);
-
-        // pass these messages to the keyboard state so that it can update the component
-        // to show on-screen which keys are being pressed on the physical midi keyboard.
-        // This call will also add midi messages to the buffer which were generated by
-        // the mouse-clicking on the on-screen keyboard.
-        keyboardState.processNextMidiBuffer (incomingMidi, 0, bufferToFill.numSamples, true);
-
-        // and now get the synth to process the midi events and generate its output.
-        synth.renderNextBlock (*bufferToFill.buffer, incomingMidi, 0, bufferToFill.numSamples);
-    }
-
-    //==============================================================================
-    // this collects real-time midi messages from the midi input device, and
-    // turns them into blocks that we can process in our audio callback
-    MidiMessageCollector midiCollector;
-
-    // this represents the state of which keys on our on-screen keyboard are held
-    // down. When the mouse is clicked on the keyboard component, this object also
-    // generates midi messages for this, which we can pass on to our synth.
-    MidiKeyboardState& keyboardState;
-
-    // the synth itself!
-    Synthesiser synth;
-    LEAF leaf;
-    char leafMemory[32];
-};
-
-//==============================================================================
-class Callback final : public AudioIODeviceCallback
-{
-public:
-    Callback (AudioSourcePlayer& playerIn, LiveScrollingAudioDisplay& displayIn)
-        : player (playerIn), display (displayIn) {}
-
-    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData,
-                                           int numInputChannels,
-                                           float* const* outputChannelData,
-                                           int numOutputChannels,
-                                           int numSamples,
-                                           const AudioIODeviceCallbackContext& context) override
-    {
-        player.audioDeviceIOCallbackWithContext (inputChannelData,
-                                                 numInputChannels,
-                                                 outputChannelData,
-                                                 numOutputChannels,
-                                                 numSamples,
-                                                 context);
-        display.audioDeviceIOCallbackWithContext (outputChannelData,
-                                                  numOutputChannels,
-                                                  nullptr,
-                                                  0,
-                                                  numSamples,
-                                                  context);
-    }
-
-    void audioDeviceAboutToStart (AudioIODevice* device) override
-    {
-        player.audioDeviceAboutToStart (device);
-        display.audioDeviceAboutToStart (device);
-    }
-
-    void audioDeviceStopped() override
-    {
-        player.audioDeviceStopped();
-        display.audioDeviceStopped();
-    }
-
-private:
-    AudioSourcePlayer& player;
-    LiveScrollingAudioDisplay& display;
-};
-
-//==============================================================================
-class AudioSynthesiserDemo final : public Component
-{
-public:
-    AudioSynthesiserDemo()
-    {
-        addAndMakeVisible (keyboardComponent);
-
-        addAndMakeVisible (sineButton);
-        sineButton.setRadioGroupId (321);
-        sineButton.setToggleState (true, dontSendNotification);
-        sineButton.onClick = [this] { synthAudioSource.setUsingSineWaveSound(); };
-
-        addAndMakeVisible (liveAudioDisplayComp);
-        
-        addAndMakeVisible (stiffness);
-        stiffness.setRange (0.0f, 2.0f);
-        stiffness.addListener(&synthAudioSource);
-        stiffness.setComponentID("stiffness");
-        
-        addAndMakeVisible (pluckPos);
-        pluckPos.setRange (0.01f, PI-0.01f);
-        pluckPos.addListener(&synthAudioSource);
-        pluckPos.setComponentID("pluck pos");
-        
-        addAndMakeVisible (pickupPos);
-        pickupPos.setRange (0.01f, PI-0.01f);
-        pickupPos.addListener(&synthAudioSource);
-        pickupPos.setComponentID("pickup pos");
-        //openAttachment.reset (new SliderAttachment (valueTreeState, "open_amount", openAmountSlider.slider));
-        
-        
-        
-        audioSourcePlayer.setSource (&synthAudioSource);
-
-       #ifndef JUCE_DEMO_RUNNER
-        audioDeviceManager.initialise (0, 2, nullptr, true, {}, nullptr);
-       #endif
-
-        audioDeviceManager.addAudioCallback (&callback);
-        audioDeviceManager.addMidiInputDeviceCallback ({}, &(synthAudioSource.midiCollector));
-
-        setOpaque (true);
-        setSize (640, 480);
-    }
-
-    ~AudioSynthesiserDemo() override
-    {
-        audioSourcePlayer.setSource (nullptr);
-        audioDeviceManager.removeMidiInputDeviceCallback ({}, &(synthAudioSource.midiCollector));
-        audioDeviceManager.removeAudioCallback (&callback);
-    }
-
-    //==============================================================================
-    void paint (Graphics& g) override
-    {
-        g.fillAll (getUIColourIfAvailable (LookAndFeel_V4::ColourScheme::UIColour::windowBackground));
-    }
-
-    void resized() override
-    {
-        keyboardComponent   .setBounds (8, 96, getWidth() - 16, 64);
-        stiffness    .setBounds (8, 256, 128, 128);
-        pluckPos    .setBounds (158, 256, 128, 128);
-        pickupPos    .setBounds (308, 256, 128, 128);
-        sineButton          .setBounds (16, 176, 150, 24);
-        sampledButton       .setBounds (16, 200, 150, 24);
-        liveAudioDisplayComp.setBounds (8, 8, getWidth() - 16, 64);
-    }
-
-private:
-    // if this PIP is running inside the demo runner, we'll use the shared device manager instead
-   #ifndef JUCE_DEMO_RUNNER
-    AudioDeviceManager audioDeviceManager;
-   #else
-    AudioDeviceManager& audioDeviceManager { getSharedAudioDeviceManager (0, 2) };
-   #endif
-
-    MidiKeyboardState keyboardState;
-    AudioSourcePlayer audioSourcePlayer;
-    SynthAudioSource synthAudioSource        { keyboardState };
-    MidiKeyboardComponent keyboardComponent  { keyboardState, MidiKeyboardComponent::horizontalKeyboard};
-
-    ToggleButton sineButton     { "Use sine wave" };
-    ToggleButton sampledButton  { "Use sampled sound" };
-    
-    Slider stiffness {"stiffness"};
-    Slider pluckPos {"pluck pos"};
-    Slider pickupPos {"pickup pos"};
-    
-    LiveScrollingAudioDisplay liveAudioDisplayComp;
-
-    Callback callback { audioSourcePlayer, liveAudioDisplayComp };
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioSynthesiserDemo)
-};
-
-
-
+/*
+  ==============================================================================
+
+   This file is part of the JUCE examples.
+   Copyright (c) 2022 - Raw Material Software Limited
+
+   The code included in this file is provided under the terms of the ISC license
+   http://www.isc.org/downloads/software-support-policy/isc-license. Permission
+   To use, copy, modify, and/or distribute this software for any purpose with or
+   without fee is hereby granted provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES,
+   WHETHER EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR
+   PURPOSE, ARE DISCLAIMED.
+
+  ==============================================================================
+*/
+
+/*******************************************************************************
+ The block below describes the properties of this PIP. A PIP is a short snippet
+ of code that can be read by the Projucer and used to generate a JUCE project.
+
+ BEGIN_JUCE_PIP_METADATA
+
+ name:             AudioSynthesiserDemo
+ version:          1.0.0
+ vendor:           JUCE
+ website:          http://juce.com
+ description:      Simple synthesiser application.
+
+ dependencies:     juce_audio_basics, juce_audio_devices, juce_audio_formats,
+                   juce_audio_processors, juce_audio_utils, juce_core,
+                   juce_data_structures, juce_events, juce_graphics,
+                   juce_gui_basics, juce_gui_extra
+ exporters:        xcode_mac, vs2022, linux_make, androidstudio, xcode_iphone
+
+ moduleFlags:      JUCE_STRICT_REFCOUNTEDPOINTER=1
+
+ type:             Component
+ mainClass:        AudioSynthesiserDemo
+
+ useLocalCopy:     1
+
+ END_JUCE_PIP_METADATA
+
+*******************************************************************************/
+
+#pragma once
+
+#include "DemoUtilities.h"
+#include "AudioLiveScrollingDisplay.h"
+#include "ModalRealtimeProfile.h"
+#include "ModalLatencyMeter.h"
+#include "ModalKeyboardState.h"
+#include "ModalAttackCache.h"
+#include "ModalLoadGovernor.h"
+#include "SubnormalCounter.h"
+#include "SnapshotPublisher.h"
+#include "ModeTable.h"
+#include "ModalRenderKernels.h"
+#include "ModalResonatorBank.h"
+#include "ModalNoiseSource.h"
+#include "ModalSympatheticStrings.h"
+#include "ModalPresetBank.h"
+#include "ModalExpression.h"
+
+
+typedef juce::AudioProcessorValueTreeState::SliderAttachment SliderAttachment;
+typedef juce::AudioProcessorValueTreeState::ButtonAttachment ButtonAttachment;
+typedef juce::AudioProcessorValueTreeState::ComboBoxAttachment ComboBoxAttachment;
+
+
+//==============================================================================
+/** Our demo synth sound is just a basic sine wave.. */
+struct SineWaveSound final : public SynthesiserSound
+{
+    bool appliesToNote (int /*midiNoteNumber*/) override    { return true; }
+    bool appliesToChannel (int /*midiChannel*/) override    { return true; }
+};
+
+//==============================================================================
+/** Our demo synth voice just plays a sine wave.. */
+struct SineWaveVoice final : public SynthesiserVoice
+{
+    SineWaveVoice()
+    {
+        static std::atomic<uint32> numVoicesCreated { 0 };
+        noise.setSeed (numVoicesCreated++);
+
+        setMaximumBlockSize (512);
+    }
+
+    /** Sets how many of the preset's pickups are used. With more
+        than one, they're spread across the output channels, so two pickups
+        give the left and right channels a different mix of the modes. This
+        takes effect from the next note.
+    */
+    void setNumPickups (int newNumPickups) noexcept     { requestedNumPickups = jlimit (1, (int) maxPickups, newNumPickups); }
+
+    /** What sets the string's modes ringing. */
+    enum class Excitation
+    {
+        pluck,          // the modes start at the amplitudes the pluck position gives them
+        audioInput,     // the modes are resonators, driven by the signal from setExcitationInput()
+        noise           // the modes are resonators, driven by filtered noise for as long as the note is held, like a bow or breath
+    };
+
+    /** Chooses how notes are excited. This takes effect from the next note. */
+    void setExcitation (Excitation newExcitation) noexcept     { requestedExcitation = newExcitation; }
+
+    /** Sets the signal that drives the resonators when the excitation is
+        audioInput. It must hold at least as many samples as the blocks passed
+        to renderNextBlock(), and is read from the same start sample. It can be
+        nullptr, in which case the resonators just ring on by themselves.
+    */
+    void setExcitationInput (const float* newInput) noexcept   { excitationInput = newInput; }
+
+    /** Gives the voice somewhere to add a mono copy of its output, for driving
+        the sympathetic strings. It's indexed by the same start sample as the
+        buffer passed to renderNextBlock(), and can be nullptr.
+    */
+    void setCouplingOutput (float* newOutput) noexcept          { couplingOutput = newOutput; }
+
+    /** Shares the per-note expression controls with the other voices, giving
+        this voice its own slot in them. Pitch bend scales every mode's
+        frequency, pressure makes the modes ring on for longer, and timbre
+        moves the pickups along the string. It can be nullptr, in which case
+        notes play without any expression.
+    */
+    void setExpression (ModalExpression* expressionToUse, int slot) noexcept
+    {
+        expression = expressionToUse;
+        expressionSlot = slot;
+    }
+
+    bool canPlaySound (SynthesiserSound* sound) override
+    {
+        return acceptingNewNotes && dynamic_cast<SineWaveSound*> (sound) != nullptr;
+    }
+
+    void startNote (int midiNoteNumber, float velocity,
+                    SynthesiserSound*, int /*currentPitchWheelPosition*/) override
+    {
+        if (!playing)
+        {
+            // everything that doesn't depend on the pluck has been worked out in advance
+            auto* table = modeTables->get();
+            jassert (table != nullptr);
+            auto cyclesPerSecond = table->noteFrequencies[midiNoteNumber];
+            for (int i = 0; i < numModes; i++)
+            {
+                modeFrequencies[i] = cyclesPerSecond * table->frequencyRatios[i];
+                decayMultipliers[i] = table->decayMultipliers[midiNoteNumber][i];
+                logDecayMultipliers[i] = std::log (decayMultipliers[i]);
+                basePhaseIncrements[i] = ModalSineKernel::phaseIncrement (modeFrequencies[i], getSampleRate());
+                phases[i] = 0;
+                initialAmplitudes[i] = table->pluckAmplitudes[i];
+            }
+            samplesSinceNoteOn = 0;
+            decayTime = 0.0;
+            pitchRatio = decayScale = 1.0;
+            rescaleModes();
+            pickupOffset = 0.0f;
+            numModesInSync = numModes;
+            noteNumber = midiNoteNumber;
+            numChannelGains = 0;    // a new note jumps straight to its own position
+
+            numPickups = requestedNumPickups;
+            setPickupWeights (*table);
+            crossfadeRemaining = 0;
+            crossfadeLength = jmax (1, roundToInt (getSampleRate() * presetCrossfadeSeconds));
+            playing = 1;
+            masterAmplitude = 0.7f * velocity;
+            excitation = requestedExcitation;
+            DBG("newnote");
+
+            // the note starts with whatever its channel's controllers are already set to
+            auto controls = startExpression();
+            applyExpression (*table, controls, 1.0f);
+
+            if (excitation != Excitation::pluck)
+            {
+                tuneResonators (*table);
+                resonators.reset();
+                updateNoiseFilter (*table);
+                noiseFilterState = 0.0f;
+            }
+            // the cache only holds a single channel, so it's no use for several pickups, and
+            // it was recorded without any expression
+            else if (attackCache != nullptr && attackCache->isEnabled() && numPickups == 1 && controls.isNeutral())
+                startUsingAttackCache (getAttackCacheKey (*table, midiNoteNumber, velocity));
+        }
+
+    }
+
+    void stopNote (float /*velocity*/, bool allowTailOff) override
+    {
+        
+        if (playing)
+        {
+            masterAmplitude = 0.0f;
+            playing = 0;
+            DBG("stopppped");
+        }
+
+        stopUsingAttackCache();
+    }
+
+    // pitch bend, pressure and timbre are taken out of the MIDI and handled by
+    // ModalExpression, so that a busy controller doesn't break up the render
+    void pitchWheelMoved (int /*newValue*/) override                              {}
+    void controllerMoved (int /*controllerNumber*/, int /*newValue*/) override    {}
+
+    void renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+    {
+        if (!playing)
+            return;
+
+        auto numModesToRender = 0;
+        auto* table = modeTables->get();
+
+        // a cached attack was recorded without any expression, so it can only be used while there's none
+        auto controls = getExpressionControls();
+
+        if (! controls.isNeutral())
+            leaveAttackCache();
+
+        // a new preset's pickups are faded in, but not while a cached attack is playing,
+        // because that was recorded with the old ones
+        if (table->version != weightsVersion && cachedSlot < 0)
+            startPickupCrossfade (*table);
+
+        if (excitation != Excitation::pluck)
+        {
+            // the resonators pick up a new table or quality limit straight away, so the tone can be changed while they ring
+            if (table->version != tunedVersion || maxModes != numModesTuned)
+                tuneResonators (*table);
+        }
+        else
+        {
+            numModesToRender = getNumModesToRender();
+        }
+
+        if (numModesToRender == 0 && cachedSlot < 0 && excitation == Excitation::pluck)
+        {
+            // every mode has been flushed, so this voice is free to play another note
+            stopNote (0.0f, false);
+            clearCurrentNote();
+            return;
+        }
+
+        if (outputBuffer.getNumChannels() != numChannelGains || stereoWidth != channelGainsWidth)
+            updateChannelGains (outputBuffer.getNumChannels());
+
+        // each pickup is rendered once in mono, and then added to each channel with its own gain
+        float* scratch[maxOutputs];
+
+        for (int output = 0; output < maxOutputs; ++output)
+            scratch[output] = pickupScratch.data() + (size_t) output * (size_t) scratchSize;
+
+        auto numInBlock = numSamples;
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = jmin (numSamples, scratchSize);
+
+            // controls that are on the move are stepped along every few samples, rather than once a block
+            if (controls.isMoving())
+                numThisTime = jmin (numThisTime, expressionStepSize);
+
+            applyExpression (*table, controls, (float) (numInBlock - numSamples + numThisTime) / (float) numInBlock);
+
+            if (excitation != Excitation::pluck)
+            {
+                const float* weights[maxOutputs];
+
+                for (int output = 0; output < getNumOutputs(); ++output)
+                    weights[output] = floatModes.outputWeights[output];
+
+                auto* input = excitation == Excitation::noise ? renderNoise (numThisTime)
+                                                              : (excitationInput != nullptr ? excitationInput + startSample : nullptr);
+
+                resonators.process (kernelVariant, input, scratch, weights, getNumOutputs(), numThisTime, masterAmplitude);
+            }
+            else switch (precision)
+            {
+                case Precision::float32:             renderWithAccuracy<float, false> (floatModes, scratch, numThisTime, numModesToRender); break;
+                case Precision::float32Compensated:  renderWithAccuracy<float, true>  (floatModes, scratch, numThisTime, numModesToRender); break;
+                case Precision::float64:             renderWithAccuracy<double, false> (doubleModes, scratch, numThisTime, numModesToRender); break;
+            }
+
+            if (crossfadeRemaining > 0)
+                applyPickupCrossfade (scratch, numThisTime);
+
+            if (couplingOutput != nullptr)
+                FloatVectorOperations::add (couplingOutput + startSample, scratch[0], numThisTime);
+
+            for (int pickup = 0; pickup < numPickups; ++pickup)
+            {
+                SubnormalCounter::check (SubnormalCounter::voiceOutput, scratch[pickup], numThisTime);
+
+                for (int channel = 0; channel < numChannelGains; ++channel)
+                {
+                    auto& gain = channelGains[pickup][channel];
+                    auto targetGain = targetChannelGains[pickup][channel];
+
+                    if (gain != targetGain)
+                    {
+                        outputBuffer.addFromWithRamp (channel, startSample, scratch[pickup], numThisTime, gain, targetGain);
+                        gain = targetGain;
+                    }
+                    else if (gain != 0.0f)
+                    {
+                        FloatVectorOperations::addWithMultiply (outputBuffer.getWritePointer (channel, startSample),
+                                                                scratch[pickup], gain, numThisTime);
+                    }
+                }
+            }
+
+            startSample += numThisTime;
+            numSamples -= numThisTime;
+        }
+    }
+
+    /** Sets the size of the block the voice renders into before adding it to
+        the output. Bigger blocks passed to renderNextBlock() still work, but
+        are rendered in several pieces. The buffers only ever grow, so this
+        only allocates if the size is bigger than it's been before, and a
+        note that's playing carries on.
+    */
+    void setMaximumBlockSize (int maximumBlockSize)
+    {
+        auto newSize = jmax (1, maximumBlockSize);
+
+        if (newSize > scratchSize)
+        {
+            scratchSize = newSize;
+            pickupScratch.assign ((size_t) scratchSize * maxOutputs, 0.0f);
+            noiseScratch.assign ((size_t) scratchSize, 0.0f);
+        }
+    }
+
+    /** Carries a note that's playing on at the new rate, with the same pitch
+        and decay, by rescaling everything that's counted in samples. The mode
+        table for the new rate must already have been published.
+    */
+    void setCurrentPlaybackSampleRate (double newRate) override
+    {
+        auto oldRate = getSampleRate();
+        auto carryOn = playing && oldRate > 0.0 && newRate != oldRate;
+
+        // a cached attack was recorded at the old rate, so the oscillators take over from it
+        if (carryOn)
+            leaveAttackCache();
+
+        SynthesiserVoice::setCurrentPlaybackSampleRate (newRate);
+
+        if (carryOn)
+            rescaleForSampleRate (oldRate / newRate);
+    }
+
+    /** Returns how much memory the voice is holding on to. */
+    size_t getReservedBytes() const noexcept
+    {
+        return sizeof (*this) + (pickupScratch.capacity() + noiseScratch.capacity()) * sizeof (float)
+                 + resonators.getReservedBytes();
+    }
+
+    /** Touches the voice and its buffers, so the audio thread doesn't fault on them. */
+    void prefault() const noexcept
+    {
+        ModalRealtimeProfile::prefault (this, sizeof (*this));
+        ModalRealtimeProfile::prefault (pickupScratch);
+        ModalRealtimeProfile::prefault (noiseScratch);
+        resonators.prefault();
+    }
+
+    /** Spreads the notes across the output channels by pitch. At 0, every note
+        is played equally on all channels; at 1, the lowest note is panned fully
+        to the first channel, the highest to the last, and the rest are panned
+        in between with an equal-power law. Changes are ramped over a block.
+    */
+    void setStereoWidth (float newWidth) noexcept               { stereoWidth = jlimit (0.0f, 1.0f, newWidth); }
+
+    /** The arithmetic used for the mode bank. Twice as many floats as doubles
+        fit in a SIMD register, and because each mode's amplitude is recomputed
+        exactly at the start of every block, float rounding errors can't build up
+        over a long note. The double version is kept as a reference to measure
+        against (see the "precision" benchmark).
+    */
+    enum class Precision
+    {
+        float32,
+        float32Compensated,     // float, with a Kahan-compensated sum of the modes
+        float64
+    };
+
+    void setPrecision (Precision newPrecision) noexcept     { precision = newPrecision; }
+    Precision getPrecision() const noexcept                 { return precision; }
+
+    /** Chooses which of the sine kernel's accuracy tiers the modes use. */
+    void setSineAccuracy (ModalSineKernel::Accuracy newAccuracy) noexcept   { sineAccuracy = newAccuracy; }
+    ModalSineKernel::Accuracy getSineAccuracy() const noexcept              { return sineAccuracy; }
+
+    /** Chooses which instruction set the render loop uses. This must be one
+        that ModalRenderKernels::detectVariant() allows on this machine.
+    */
+    void setKernelVariant (ModalRenderKernels::Variant newVariant) noexcept  { kernelVariant = newVariant; }
+
+    /** Shares a cache of pre-rendered attacks with the other voices, or
+        disables caching if this is nullptr.
+    */
+    void setAttackCache (ModalAttackCache* cacheToUse)      { attackCache = cacheToUse; }
+
+    /** Sets where the voice gets its mode frequencies and decay rates from.
+        This must have a table published before the first note is played.
+    */
+    void setModeTables (SnapshotPublisher<ModeTable>* tablesToUse)   { modeTables = tablesToUse; }
+
+    /** Limits how much work the voice does, for when the CPU is overloaded.
+        The highest modes are dropped first, along with any modes at the top
+        of the range that have become quieter than the given level. Resonators
+        driven by the audio input or by noise only drop the highest modes. A voice
+        that isn't accepting new notes will finish its current one, but won't
+        be given another until this is called again with acceptNewNotes = true.
+    */
+    void setQualityLimits (int maxModesToRender, float quietModeGain, bool acceptNewNotes) noexcept
+    {
+        maxModes = jlimit (1, numModes, maxModesToRender);
+        quietModeThreshold = quietModeGain;
+        acceptingNewNotes = acceptNewNotes;
+    }
+
+    /** Turns off the flushing of modes that have decayed far below audibility.
+        This is only useful for measuring what the flushing saves.
+    */
+    void setFlushDecayedModes (bool shouldFlush) noexcept       { flushDecayedModes = shouldFlush; }
+
+    /** Jumps the playing note forward by the given number of samples without
+        rendering them. Each mode is a damped sinusoid, so its phase and
+        amplitude at any later time can be computed directly.
+    */
+    void seek (int64 numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+
+        if (cachedSlot >= 0)
+        {
+            auto remainingInCache = attackCache->getAttackLength() - cachePosition;
+
+            if (numSamples < remainingInCache)
+            {
+                cachePosition += (int) numSamples;
+                return;
+            }
+
+            // the oscillators are already waiting at the end of the cached attack
+            numSamples -= remainingInCache;
+        }
+
+        stopUsingAttackCache();
+        advanceModes (numSamples);
+    }
+
+    /** Returns how many more samples it will take for the note to fall below
+        the given level. This uses the sum of all the mode amplitudes, so it
+        never underestimates.
+    */
+    int64 getSamplesUntilSilent (float thresholdGain) const
+    {
+        if (! playing)
+            return 0;
+
+        auto levelAfter = [this] (int64 numSamples)
+        {
+            double sum = 0.0;
+
+            for (int j = 0; j < numModes; j++)
+                sum += std::abs (initialAmplitudes[j] * loudestWeights[j]) * pow (decayMultipliers[j], decayTime + (double) numSamples);
+
+            return sum * masterAmplitude;
+        };
+
+        auto remainingInCache = cachedSlot >= 0 ? (int64) (attackCache->getAttackLength() - cachePosition) : (int64) 0;
+
+        if (levelAfter (0) < thresholdGain)
+            return remainingInCache;
+
+        int64 silent = 1;
+
+        while (levelAfter (silent) >= thresholdGain && silent < ((int64) 1 << 40))
+            silent *= 2;
+
+        for (auto loud = silent / 2; silent - loud > 1;)
+        {
+            auto mid = (loud + silent) / 2;
+
+            if (levelAfter (mid) < thresholdGain)
+                silent = mid;
+            else
+                loud = mid;
+        }
+
+        return remainingInCache + silent;
+    }
+
+    using SynthesiserVoice::renderNextBlock;
+    const static int numModes = ModeTable::numModes;
+    static constexpr int maxPickups = ModalRenderKernels::maxPickups;
+private:
+    static constexpr int maxOutputs = ModalRenderKernels::maxOutputs;
+
+    /** The oscillators are processed in whole groups of lanes, so the arrays
+        have room for a few silent modes on the end.
+    */
+    static constexpr int numPaddedModes = ModalSineKernel::roundUpToLanes (numModes);
+
+    /** The per-sample working state of the modes, in one precision. */
+    template <typename FloatType>
+    struct ModeState
+    {
+        FloatType amplitudes[numPaddedModes] = {};
+        FloatType outputWeights[maxOutputs][numPaddedModes] = {};     // the current pickups, then the ones being faded out
+        FloatType decayMultipliers[numPaddedModes] = {};
+        FloatType modeOutputs[numPaddedModes] = {};
+    };
+
+    template <typename FloatType, bool compensated>
+    void renderWithAccuracy (ModeState<FloatType>& modes, float* const* outputs, int numSamples, int numModesToRender)
+    {
+        using Accuracy = ModalSineKernel::Accuracy;
+
+        switch (sineAccuracy)
+        {
+            case Accuracy::fast:      renderModes<FloatType, compensated, Accuracy::fast>     (modes, outputs, numSamples, numModesToRender); break;
+            case Accuracy::standard:  renderModes<FloatType, compensated, Accuracy::standard> (modes, outputs, numSamples, numModesToRender); break;
+            case Accuracy::precise:   renderModes<FloatType, compensated, Accuracy::precise>  (modes, outputs, numSamples, numModesToRender); break;
+        }
+    }
+
+    /** Renders the output of each pickup, replacing what's in the output arrays. */
+    template <typename FloatType, bool compensated, ModalSineKernel::Accuracy accuracy>
+    void renderModes (ModeState<FloatType>& modes, float* const* outputs, int numSamples, int numModesToRender)
+    {
+        SubnormalCounter::check (SubnormalCounter::modeAmplitudes, modes.amplitudes, numModesToRender);
+
+        int numFromCache = 0;
+
+        if (cachedSlot >= 0)
+        {
+            // the oscillators were already moved past the attack in startNote
+            numFromCache = jmin (numSamples, attackCache->getAttackLength() - cachePosition);
+            FloatVectorOperations::copy (outputs[0], attackCache->getSamples (cachedSlot) + cachePosition, numFromCache);
+            cachePosition += numFromCache;
+
+            if (cachePosition == attackCache->getAttackLength())
+                stopUsingAttackCache();
+        }
+
+        if (numSamples > numFromCache)
+        {
+            ModalRenderKernels::ModeBank<FloatType> bank { phases, phaseIncrements, modes.amplitudes, modes.decayMultipliers, {},
+                                                           modes.modeOutputs, numModesToRender, getNumOutputs(), masterAmplitude };
+            float* pickupOutputs[maxOutputs] = {};
+
+            for (int output = 0; output < getNumOutputs(); ++output)
+            {
+                bank.outputWeights[output] = modes.outputWeights[output];
+                pickupOutputs[output] = outputs[output] + numFromCache;
+            }
+
+            ModalRenderKernels::render<FloatType, compensated, accuracy> (kernelVariant, pickupOutputs, numSamples - numFromCache, bank);
+            samplesSinceNoteOn += numSamples - numFromCache;
+            decayTime += (numSamples - numFromCache) * decayScale;
+
+            if (recordingSlot >= 0)
+                recordAttackSamples (pickupOutputs[0], numSamples - numFromCache);
+        }
+    }
+
+    /** Adds an equal-power pan between the two nearest of a row of channels,
+        where a position of 0 is the first channel and 1 is the last.
+    */
+    static void addPannedGains (float* gains, int numChannels, float position, float amount) noexcept
+    {
+        if (numChannels == 1)
+        {
+            gains[0] += amount;
+            return;
+        }
+
+        auto scaledPosition = position * (float) (numChannels - 1);
+        auto lower = jlimit (0, numChannels - 2, (int) scaledPosition);
+        auto angle = (scaledPosition - (float) lower) * MathConstants<float>::halfPi;
+
+        gains[lower]     += amount * std::cos (angle);
+        gains[lower + 1] += amount * std::sin (angle);
+    }
+
+    /** Works out how loud each pickup should be in each output channel. The
+        pickups are spread evenly across the channels, and the whole note is
+        then panned by its pitch, depending on the stereo width.
+    */
+    void updateChannelGains (int numChannels) noexcept
+    {
+        jassert (numChannels <= maxOutputChannels);
+        numChannels = jmin (numChannels, (int) maxOutputChannels);
+
+        float noteGains[maxOutputChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            noteGains[channel] = 1.0f - stereoWidth;
+
+        addPannedGains (noteGains, numChannels, jlimit (0, 127, noteNumber) / 127.0f, stereoWidth);
+
+        for (int pickup = 0; pickup < numPickups; ++pickup)
+        {
+            float pickupGains[maxOutputChannels] = {};
+
+            if (numPickups == 1)
+                std::fill (pickupGains, pickupGains + numChannels, 1.0f);
+            else
+                addPannedGains (pickupGains, numChannels, (float) pickup / (float) (numPickups - 1), 1.0f);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                targetChannelGains[pickup][channel] = pickupGains[channel] * noteGains[channel];
+        }
+
+        // when the channel layout changes, there's nothing sensible to ramp from
+        if (numChannels != numChannelGains)
+            for (int pickup = 0; pickup < numPickups; ++pickup)
+                for (int channel = 0; channel < numChannels; ++channel)
+                    channelGains[pickup][channel] = targetChannelGains[pickup][channel];
+
+        numChannelGains = numChannels;
+        channelGainsWidth = stereoWidth;
+    }
+
+    /** While a crossfade is running, the old pickups are rendered as well as
+        the new ones.
+    */
+    int getNumOutputs() const noexcept          { return crossfadeRemaining > 0 ? 2 * numPickups : numPickups; }
+
+    /** Takes the pickup weights for the current number of pickups from a table,
+        moved along the string by the note's timbre.
+    */
+    void setPickupWeights (const ModeTable& table) noexcept
+    {
+        for (int pickup = 0; pickup < numPickups; ++pickup)
+        {
+            for (int i = 0; i < numModes; i++)
+            {
+                auto weight = getPickupWeight (table, pickup, i);
+                doubleModes.outputWeights[pickup][i] = weight;
+                floatModes.outputWeights[pickup][i] = weight;
+            }
+
+            pickupPositions[pickup] = table.preset.pickupPositions[pickup];
+        }
+
+        // the level and length of the note are judged by whichever pickup hears each mode best
+        for (int i = 0; i < numModes; i++)
+        {
+            loudestWeights[i] = 0.0;
+
+            for (int pickup = 0; pickup < numPickups; ++pickup)
+                loudestWeights[i] = jmax (loudestWeights[i], (double) std::abs (table.pickupWeights[pickup][i]));
+        }
+
+        weightsVersion = table.version;
+    }
+
+    /** Returns the table's weight for a pickup, moved by as much as the string
+        model says that moving the pickup by the timbre's offset would change
+        it. For a preset that follows the model, that's the weight at the new
+        position; an analysed one keeps its own shape, and there's no jump as
+        the offset leaves zero.
+    */
+    float getPickupWeight (const ModeTable& table, int pickup, int mode) const noexcept
+    {
+        auto position = table.preset.pickupPositions[pickup];
+        auto harmonic = (float) (mode + 1);
+
+        return table.pickupWeights[pickup][mode]
+                 + std::sin (harmonic * (position + pickupOffset)) - std::sin (harmonic * position);
+    }
+
+    /** Moves the pickups to where a newly published table has them, fading
+        from what's being heard now so that the switch doesn't click.
+    */
+    void startPickupCrossfade (const ModeTable& table) noexcept
+    {
+        // an analysed preset can have different weights for pickups in the same place, so
+        // it's the weights that are compared
+        auto weightsMatch = [&]
+        {
+            for (int pickup = 0; pickup < numPickups; ++pickup)
+                for (int i = 0; i < numModes; i++)
+                    if (floatModes.outputWeights[pickup][i] != getPickupWeight (table, pickup, i))
+                        return false;
+
+            return true;
+        };
+
+        if (weightsMatch())
+        {
+            setPickupWeights (table);
+            return;
+        }
+
+        // an attack that's being recorded won't match its key any more
+        if (recordingSlot >= 0)
+        {
+            attackCache->finishRecording (recordingSlot, false);
+            recordingSlot = -1;
+        }
+
+        // if a fade is already under way, the new one starts from the mix that's playing now
+        auto progress = crossfadeRemaining > 0 ? 1.0 - (double) crossfadeRemaining / crossfadeLength : 1.0;
+
+        for (int pickup = 0; pickup < numPickups; ++pickup)
+        {
+            auto* current = doubleModes.outputWeights[pickup];
+            auto* previous = doubleModes.outputWeights[numPickups + pickup];
+
+            for (int i = 0; i < numPaddedModes; i++)
+            {
+                previous[i] += (current[i] - previous[i]) * progress;
+                floatModes.outputWeights[numPickups + pickup][i] = (float) previous[i];
+            }
+        }
+
+        setPickupWeights (table);
+        crossfadeRemaining = crossfadeLength;
+    }
+
+    /** Mixes each pickup's old and new outputs together, following a linear ramp. */
+    void applyPickupCrossfade (float* const* outputs, int numSamples) noexcept
+    {
+        auto numFading = jmin (numSamples, crossfadeRemaining);
+        auto step = 1.0f / (float) crossfadeLength;
+        auto startFade = (float) (crossfadeLength - crossfadeRemaining) * step;
+
+        for (int pickup = 0; pickup < numPickups; ++pickup)
+        {
+            auto* current = outputs[pickup];
+            auto* previous = outputs[numPickups + pickup];
+
+            for (int i = 0; i < numFading; ++i)
+                current[i] = previous[i] + (current[i] - previous[i]) * (startFade + (float) (i + 1) * step);
+        }
+
+        crossfadeRemaining -= numFading;
+    }
+
+    ModalAttackCache::Key getAttackCacheKey (const ModeTable& table, int midiNoteNumber, float velocity) const noexcept
+    {
+        auto& preset = table.preset;
+        return { midiNoteNumber, velocity, preset.stiffness, preset.pluckPos, preset.pickupPositions[0], preset.decay, preset.decayHighFreq,
+                 table.modesHash };
+    }
+
+    /** Sets the resonators to the current note's modes in the given table,
+        leaving out the highest ones if the quality limits say so.
+    */
+    void tuneResonators (const ModeTable& table) noexcept
+    {
+        auto cyclesPerSecond = table.noteFrequencies[noteNumber];
+
+        // modes that are dropped are silenced, so that they start again from nothing when they come back
+        for (int i = maxModes; i < resonators.getNumResonators(); i++)
+            resonators.mute (i);
+
+        for (int i = 0; i < maxModes; i++)
+        {
+            auto frequency = cyclesPerSecond * table.frequencyRatios[i] * pitchRatio;
+
+            // a resonator can't go past Nyquist, so one that's bent up there is left out until it comes back down
+            if (frequency < 0.5 * getSampleRate())
+                resonators.tune (i, frequency, std::pow (table.decayMultipliers[noteNumber][i], decayScale), getSampleRate());
+            else
+                resonators.mute (i);
+        }
+
+        resonators.setNumResonators (maxModes);
+        tunedVersion = table.version;
+        numModesTuned = maxModes;
+    }
+
+    //==============================================================================
+    /** Points the expression at the channel of the note that's just started, and
+        returns its controls.
+    */
+    ModalExpression::VoiceControls startExpression() noexcept
+    {
+        if (expression != nullptr)
+        {
+            for (int channel = 1; channel <= 16; ++channel)
+            {
+                if (isPlayingChannel (channel))
+                {
+                    expression->startVoice (expressionSlot, channel);
+                    break;
+                }
+            }
+        }
+
+        return getExpressionControls();
+    }
+
+    ModalExpression::VoiceControls getExpressionControls() const noexcept
+    {
+        return expression != nullptr ? expression->getControls (expressionSlot) : ModalExpression::VoiceControls {};
+    }
+
+    /** Sets the modes to where the expression controls are at a point in the
+        current block. Anything that hasn't changed is left alone.
+    */
+    void applyExpression (const ModeTable& table, const ModalExpression::VoiceControls& controls, float proportion) noexcept
+    {
+        auto newPitchRatio = std::exp2 ((double) controls.get (ModalExpression::pitchBend, proportion) / 12.0);
+        auto newDecayScale = std::exp2 (-pressureSustain * (double) controls.get (ModalExpression::pressure, proportion));
+        auto newPickupOffset = (controls.get (ModalExpression::timbre, proportion) - 0.5f) * timbrePickupRange;
+
+        if (newPitchRatio != pitchRatio || newDecayScale != decayScale)
+        {
+            pitchRatio = newPitchRatio;
+            decayScale = newDecayScale;
+
+            if (excitation != Excitation::pluck)
+                tuneResonators (table);
+            else
+                rescaleModes();
+        }
+
+        if (newPickupOffset != pickupOffset)
+        {
+            pickupOffset = newPickupOffset;
+            setPickupWeights (table);
+        }
+    }
+
+    /** Scales the oscillators' frequencies by the pitch bend, and their decay
+        rates by the pressure. These are plain loops over all the modes, which
+        the compiler vectorises.
+
+        A mode at or above Nyquist would wrap round in its phase and alias, so
+        it's silenced for as long as it stays up there.
+    */
+    void rescaleModes() noexcept
+    {
+        auto nyquist = 0.5 * getSampleRate() / pitchRatio;
+
+        // a phase increment is a fraction of a cycle, so it wraps just like phaseFromCycles() does
+        for (int i = 0; i < numPaddedModes; i++)
+        {
+            phaseIncrements[i] = (ModalSineKernel::Phase) (uint64) ((double) basePhaseIncrements[i] * pitchRatio);
+            modeGains[i] = (double) modeFrequencies[i] < nyquist ? 1.0 : 0.0;
+        }
+
+        for (int i = 0; i < numModes; i++)
+        {
+            auto multiplier = decayScale == 1.0 ? decayMultipliers[i] : std::exp (logDecayMultipliers[i] * decayScale);
+            doubleModes.decayMultipliers[i] = multiplier;
+            floatModes.decayMultipliers[i] = (float) multiplier;
+            doubleModes.amplitudes[i] *= modeGains[i];
+            floatModes.amplitudes[i] *= (float) modeGains[i];
+        }
+    }
+
+    /** Moves the playing note over to a new sample rate, given how much longer
+        a sample is now than it was. The phases carry on from where they are,
+        and the amplitudes depend on decayTime and the decay multipliers only
+        through their product, so scaling one against the other keeps them
+        where they were.
+    */
+    void rescaleForSampleRate (double sampleLengthRatio) noexcept
+    {
+        for (int i = 0; i < numModes; i++)
+        {
+            basePhaseIncrements[i] = ModalSineKernel::phaseIncrement (modeFrequencies[i], getSampleRate());
+            logDecayMultipliers[i] *= sampleLengthRatio;
+            decayMultipliers[i] = std::exp (logDecayMultipliers[i]);
+        }
+
+        samplesSinceNoteOn = (int64) std::llround ((double) samplesSinceNoteOn / sampleLengthRatio);
+        decayTime /= sampleLengthRatio;
+
+        auto fadeProgress = (double) crossfadeRemaining / crossfadeLength;
+        crossfadeLength = jmax (1, roundToInt (getSampleRate() * presetCrossfadeSeconds));
+        crossfadeRemaining = roundToInt (fadeProgress * crossfadeLength);
+
+        rescaleModes();
+
+        if (excitation != Excitation::pluck)
+        {
+            auto& table = *modeTables->get();
+            tuneResonators (table);
+            updateNoiseFilter (table);
+        }
+    }
+
+    /** Carries on from partway through a cached attack by running the
+        oscillators instead.
+    */
+    void leaveAttackCache()
+    {
+        if (cachedSlot >= 0)
+        {
+            // the oscillators were moved to the end of the attack when it started, so they're moved back
+            // to the point it's got to; nothing has bent the note so far, so their phases are easy to find
+            auto numUnplayed = attackCache->getAttackLength() - cachePosition;
+            samplesSinceNoteOn -= numUnplayed;
+            decayTime -= numUnplayed;
+
+            for (int j = 0; j < numModes; j++)
+                syncModePhase (j);
+
+            numModesInSync = numModes;
+        }
+
+        stopUsingAttackCache();
+    }
+
+    /** The noise is rolled off above the first few partials, which is roughly what a bow sounds like. */
+    void updateNoiseFilter (const ModeTable& table) noexcept
+    {
+        auto cutoff = 4.0 * table.noteFrequencies[noteNumber];
+        noiseFilterCoefficient = (float) (1.0 - std::exp (-MathConstants<double>::twoPi * cutoff / getSampleRate()));
+    }
+
+    /** Renders a block of low-passed noise to drive the resonators with. */
+    const float* renderNoise (int numSamples) noexcept
+    {
+        auto* samples = noiseScratch.data();
+        noise.render (samples, numSamples);
+
+        auto state = noiseFilterState;
+
+        for (int i = 0; i < numSamples; ++i)
+            samples[i] = state += noiseFilterCoefficient * (noiseGain * samples[i] - state);
+
+        noiseFilterState = state;
+        return samples;
+    }
+
+    void advanceModes (int64 numSamples)
+    {
+        samplesSinceNoteOn += numSamples;
+        decayTime += (double) numSamples * decayScale;
+
+        for (int j = 0; j < numModes; j++)
+            syncModePhase (j);
+
+        numModesInSync = numModes;
+    }
+
+    /** Sets a mode's phase to where it should be at the current time since
+        the note started. The amplitudes are brought up to date at the start
+        of every block anyway.
+    */
+    void syncModePhase (int j)
+    {
+        phases[j] = ModalSineKernel::phaseFromCycles ((double) modeFrequencies[j] * samplesSinceNoteOn / getSampleRate());
+    }
+
+    int getNumModesToRender()
+    {
+        auto& amplitudes = doubleModes.amplitudes;
+
+        // working each amplitude out from scratch once per block stops rounding
+        // errors in the per-sample decay from building up, whatever the precision
+        for (int j = 0; j < numModes; j++)
+        {
+            auto amplitude = initialAmplitudes[j] * pow (decayMultipliers[j], decayTime);
+
+            // modes this far down will never be heard again, and if left alone they'd
+            // eventually become subnormal, which is very slow to process
+            if (flushDecayedModes && std::abs (amplitude) < decayedModeLevel)
+                amplitude = initialAmplitudes[j] = 0.0;
+
+            amplitude *= modeGains[j];
+            amplitudes[j] = amplitude;
+            floatModes.amplitudes[j] = (float) amplitude;
+        }
+
+        auto numToRender = maxModes;
+
+        while (numToRender > 0 && (amplitudes[numToRender - 1] == 0.0
+                                    || (numToRender > 1 && std::abs (amplitudes[numToRender - 1] * loudestWeights[numToRender - 1]) * masterAmplitude < quietModeThreshold)))
+            --numToRender;
+
+        // the oscillators are processed in groups, and the rest of a group costs almost nothing
+        if (numToRender > 0)
+            numToRender = jmin (numPaddedModes, ModalSineKernel::roundUpToLanes (numToRender));
+
+        // modes that were skipped while the quality was reduced have to catch up before being heard again
+        for (int j = numModesInSync; j < jmin (numToRender, numModes); j++)
+            syncModePhase (j);
+
+        numModesInSync = numToRender;
+        return numToRender;
+    }
+
+    void startUsingAttackCache (const ModalAttackCache::Key& key)
+    {
+        cachedSlot = attackCache->acquire (key);
+
+        if (cachedSlot >= 0)
+        {
+            cachePosition = 0;
+            advanceModes (attackCache->getAttackLength());
+        }
+        else
+        {
+            recordingSlot = attackCache->beginRecording (key);
+            cachePosition = 0;
+            recordingWasLimited = false;
+        }
+    }
+
+    void stopUsingAttackCache()
+    {
+        if (cachedSlot >= 0)
+            attackCache->release (cachedSlot);
+
+        if (recordingSlot >= 0)
+            attackCache->finishRecording (recordingSlot, false);
+
+        cachedSlot = recordingSlot = -1;
+    }
+
+    void recordAttackSamples (const float* samples, int numSamples)
+    {
+        auto numToRecord = jmin (numSamples, attackCache->getAttackLength() - cachePosition);
+
+        // an attack rendered with modes dropped would go on being played long after the load has eased
+        recordingWasLimited = recordingWasLimited || maxModes < numModes || quietModeThreshold > 0.0f;
+        FloatVectorOperations::copy (attackCache->getSamples (recordingSlot) + cachePosition, samples, numToRecord);
+        cachePosition += numToRecord;
+
+        if (cachePosition == attackCache->getAttackLength())
+        {
+            // if the pickup moved while we were recording, this attack doesn't match its key any more
+            auto& key = attackCache->getKey (recordingSlot);
+            attackCache->finishRecording (recordingSlot, key.pickupPos == pickupPositions[0] && crossfadeRemaining == 0
+                                                           && ! recordingWasLimited);
+            recordingSlot = -1;
+        }
+    }
+
+    float masterAmplitude = 0.0f;
+
+    float pickupPositions[maxPickups] = {};
+    double loudestWeights[numModes] = {0.0f};
+    double initialAmplitudes[numModes] = {0.0f};
+    double decayMultipliers[numModes] = {0.0f};
+    double logDecayMultipliers[numModes] = {};
+    float modeFrequencies[numPaddedModes] = {0.0f};
+    double modeGains[numPaddedModes] = {};     // 0 for modes bent past Nyquist
+
+    Precision precision = Precision::float32;
+    ModeState<float> floatModes;
+    ModeState<double> doubleModes;
+
+    ModalSineKernel::Phase phases[numPaddedModes] = {};
+    ModalSineKernel::Phase phaseIncrements[numPaddedModes] = {};
+    ModalSineKernel::Phase basePhaseIncrements[numPaddedModes] = {};     // before any pitch bend
+    ModalSineKernel::Accuracy sineAccuracy = ModalSineKernel::Accuracy::standard;
+    ModalRenderKernels::Variant kernelVariant = ModalRenderKernels::Variant::generic;
+
+    static constexpr int maxOutputChannels = 64;
+    std::vector<float> pickupScratch;
+    int scratchSize = 0;
+    int numPickups = 1, requestedNumPickups = 1;
+
+    // when a preset moves the pickups, the voice fades over to them
+    uint64 weightsVersion = 0;
+    int crossfadeRemaining = 0, crossfadeLength = 1;
+    static constexpr double presetCrossfadeSeconds = 0.02;
+    float channelGains[maxPickups][maxOutputChannels] = {}, targetChannelGains[maxPickups][maxOutputChannels] = {};
+    int numChannelGains = 0, noteNumber = 60;
+    float stereoWidth = 0.0f, channelGainsWidth = 0.0f;
+
+    Excitation excitation = Excitation::pluck, requestedExcitation = Excitation::pluck;
+    ModalResonatorBank resonators { numModes };
+    uint64 tunedVersion = 0;
+    int numModesTuned = numModes;
+    const float* excitationInput = nullptr;
+    float* couplingOutput = nullptr;
+
+    ModalNoiseSource noise;
+    std::vector<float> noiseScratch;
+    float noiseFilterCoefficient = 1.0f, noiseFilterState = 0.0f;
+
+    // the resonators only pass a narrow band of the noise each, so it needs a lot
+    // of gain to come out at around the same level as a pluck
+    static constexpr float noiseGain = 50.0f;
+
+    int playing = 0;
+
+    SnapshotPublisher<ModeTable>* modeTables = nullptr;
+    ModalAttackCache* attackCache = nullptr;
+    int cachedSlot = -1, recordingSlot = -1, cachePosition = 0;
+    bool recordingWasLimited = false;
+    int64 samplesSinceNoteOn = 0;
+
+    // how far the modes have decayed, in samples at their normal rate; pressure slows this down
+    double decayTime = 0.0;
+
+    // where the note's expression has taken it
+    ModalExpression* expression = nullptr;
+    int expressionSlot = 0;
+    double pitchRatio = 1.0, decayScale = 1.0;
+    float pickupOffset = 0.0f;
+    static constexpr int expressionStepSize = 32;
+    static constexpr double pressureSustain = 2.0;      // full pressure makes the modes ring four times as long
+    static constexpr float timbrePickupRange = 1.0f;    // how far the pickups move from the lowest timbre to the highest
+
+    int maxModes = numModes, numModesInSync = numModes;
+    float quietModeThreshold = 0.0f;
+    bool acceptingNewNotes = true;
+
+    bool flushDecayedModes = true;
+    static constexpr double decayedModeLevel = 1.0e-15;  // -300 dB
+
+};
+
+//==============================================================================
+/** A Synthesiser that lets the notes that are playing carry on through a
+    change of sample rate, rather than stopping them all as the base class
+    does. The voices take care of retuning themselves.
+*/
+class ModalSynthesiser : public Synthesiser
+{
+public:
+    void setCurrentPlaybackSampleRate (double newRate) override
+    {
+        const ScopedValueSetter<bool> keepNotes (changingSampleRate, true);
+        Synthesiser::setCurrentPlaybackSampleRate (newRate);
+    }
+
+    void allNotesOff (int midiChannel, bool allowTailOff) override
+    {
+        if (! changingSampleRate)
+            Synthesiser::allNotesOff (midiChannel, allowTailOff);
+    }
+
+private:
+    bool changingSampleRate = false;
+};
+
+class LabeledSlider : public GroupComponent
+{
+public:
+    LabeledSlider (const String& name)
+    {
+        setText (name);
+        setTextLabelPosition (Justification::centredTop);
+        addAndMakeVisible (slider);
+    }
+    
+    void resized() override
+    {
+        slider.setBounds (getLocalBounds().reduced (.5));
+    }
+    
+    Slider slider { Slider::RotaryHorizontalVerticalDrag, Slider::TextBoxBelow };
+};
+//==============================================================================
+// This is an audio source that streams the output of our demo synth.
+struct SynthAudioSource final : public AudioSource, public juce::Slider::Listener
+{
+
+    SynthAudioSource (ModalKeyboardState& keyState)  : keyboardState (keyState)
+    {
+        modeTables.publish (std::make_unique<ModeTable> (preset, presetModes, currentSampleRate.load()));
+        tailLengthSeconds = getTailLength (presetModes);
+
+        // Add some voices to our synth, to play the sounds..
+        for (auto i = 0; i < numVoices; ++i)
+        {
+            auto* voice = new SineWaveVoice();   // These voices will play our custom sine-wave sounds..
+            voice->setModeTables (&modeTables);
+            voice->setAttackCache (&attackCache);
+            voice->setExpression (&expression, i);
+            synth.addVoice (voice);
+        }
+
+        // ..and add a sound for them to play...
+        setUsingSineWaveSound();
+    }
+
+    /** Something that adds MIDI to each block at exact sample positions, rather
+        than at whenever it arrived, such as a fixed schedule of test notes.
+    */
+    struct MidiSource
+    {
+        virtual ~MidiSource() = default;
+
+        /** Called from prepareToPlay(). */
+        virtual void prepareToPlay (double sampleRate) = 0;
+
+        /** Called on the audio thread to add the next block's messages. */
+        virtual void addNextBlock (MidiBuffer& midi, int numSamples) = 0;
+    };
+
+    /** Sets a source of MIDI to be played along with the MIDI input. Call this
+        before the audio starts.
+    */
+    void setMidiSource (MidiSource* newSource) noexcept     { midiSource = newSource; }
+
+    void setUsingSineWaveSound()
+    {
+        synth.clearSounds();
+        synth.addSound (new SineWaveSound());
+    }
+
+    void sliderValueChanged(juce::Slider* slider) override
+    {
+        setParameter (slider->getComponentID(), (float) slider->getValue());
+    }
+
+    /** Changes one of the continuous settings, given the ID that both the demo's
+        sliders and the plugin's parameters use for it. A change to the preset
+        rebuilds the mode table, so this must be called on the message thread.
+    */
+    void setParameter (const String& id, float value)
+    {
+        if (id == "stereoWidth")
+            stereoWidth = value;
+
+        if (id == "sympathetic")
+            sympatheticLevel = value;
+
+        if (id == "stiffness" || id == "pluckPos" || id == "pickupPos" || id == "secondPickupPos")
+        {
+            // only the modes that depend on the setting are worked out again, so the rest of
+            // an analysed preset is kept
+            if (id == "stiffness")          { preset.stiffness = value;             presetModes.setFrequenciesAndDampings (preset); }
+            if (id == "pluckPos")           { preset.pluckPos = value;              presetModes.setAmplitudes (preset); }
+            if (id == "pickupPos")          { preset.pickupPositions[0] = value;    presetModes.setPickupWeights (preset); }
+            if (id == "secondPickupPos")    { preset.pickupPositions[1] = value;    presetModes.setPickupWeights (preset); }
+
+            publishModeTable();
+        }
+    }
+
+    /** Switches to a new preset. The voices fade over to it without stopping. */
+    void loadPreset (const ModalPreset& newPreset, const ModalPresetModes& newModes)
+    {
+        preset = newPreset;
+        presetModes = newModes;
+        publishModeTable();
+    }
+
+    void loadPreset (const ModalPreset& newPreset)      { loadPreset (newPreset, ModalPresetModes (newPreset)); }
+
+    const ModalPreset& getPreset() const noexcept   { return preset; }
+
+    /** Gets everything ready for a sample rate and block size. This can be
+        called again when the device changes without stopping the notes that
+        are playing: they're retuned for the new rate, and the buffers are only
+        reallocated if the blocks have got bigger than they've been before.
+        Like the preset changes, this has to be called on the message thread.
+    */
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
+    {
+        auto blockSize = jmax (1, samplesPerBlockExpected);
+
+        midiCollector.reset (sampleRate);
+
+        if (midiSource != nullptr)
+            midiSource->prepareToPlay (sampleRate);
+
+        // the voices retune themselves from the new rate's table, so it's published first. Any
+        // tables still waiting to be built are for the old rate, so they're skipped, and one that's
+        // already being built is waited for so that it can't be published over this one
+        currentSampleRate = sampleRate;
+        ++numTableRequests;
+        tableBuilder.removeAllJobs (false, -1);
+        modeTables.publish (std::make_unique<ModeTable> (preset, presetModes, sampleRate));
+
+        // this also makes the voices let go of their cache slots if the rate has changed,
+        // before the cache is cut up into attacks of a different length
+        synth.setCurrentPlaybackSampleRate (sampleRate);
+        attackCache.prepare (sampleRate);
+        expression.prepare (sampleRate, maxMidiBytesPerBlock);
+        incomingMidi.ensureSize (maxMidiBytesPerBlock);
+
+        kernelVariant = ModalRenderKernels::detectVariant();
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+        {
+            auto* voice = (SineWaveVoice*)synth.getVoice(i);
+            voice->setKernelVariant (kernelVariant);
+            voice->setMaximumBlockSize (blockSize);
+        }
+
+        // the strings keep ringing through a change of rate, and are only rebuilt for bigger blocks
+        if (sympatheticStrings == nullptr || sympatheticStrings->getMaxBlockSize() < blockSize)
+            sympatheticStrings = std::make_unique<ModalSympatheticStrings> (numSympatheticStrings, lowestSympatheticNote,
+                                                                            jmin (synth.getNumVoices(), (int) maxCouplingVoices),
+                                                                            blockSize);
+
+        // both of these are laid out in blocks of the strings' size
+        auto scratchSize = (size_t) sympatheticStrings->getMaxBlockSize();
+
+        if (inputScratch.size() < scratchSize)
+            inputScratch.assign (scratchSize, 0.0f);
+
+        if (voiceOutputs.size() != scratchSize * (size_t) synth.getNumVoices())
+            voiceOutputs.assign (scratchSize * (size_t) synth.getNumVoices(), 0.0f);
+
+        loadGovernor.prepare (sampleRate, blockSize);
+        reservedBytes = getReservedBytes();
+        modeTables.setAudioRunning (true);
+    }
+
+    /** Adds up how much memory has been set aside for the audio thread. */
+    size_t getReservedBytes() const
+    {
+        auto total = attackCache.getReservedBytes() + expression.getReservedBytes()
+                       + (inputScratch.capacity() + voiceOutputs.capacity()) * sizeof (float)
+                       + (size_t) maxMidiBytesPerBlock;
+
+        if (sympatheticStrings != nullptr)
+            total += sympatheticStrings->getReservedBytes();
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+            total += ((SineWaveVoice*)synth.getVoice(i))->getReservedBytes();
+
+        return total;
+    }
+
+    /** Touches every page of the memory counted by getReservedBytes(), so
+        that the first blocks after a device starts don't stall on page faults.
+        Call this after prepareToPlay(), before the audio thread starts.
+    */
+    void prefaultMemory() const
+    {
+        attackCache.prefault();
+        expression.prefault();
+        ModalRealtimeProfile::prefault (inputScratch);
+        ModalRealtimeProfile::prefault (voiceOutputs);
+
+        if (sympatheticStrings != nullptr)
+            sympatheticStrings->prefault();
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+            ((SineWaveVoice*)synth.getVoice(i))->prefault();
+    }
+
+    void releaseResources() override
+    {
+        modeTables.setAudioRunning (false);
+    }
+
+    /** Rebuilds the mode table for the current preset and sample rate on a
+        background thread, and hands it to the voices. While a slider is being
+        dragged, only the latest of any requests still waiting gets built.
+    */
+    void publishModeTable()
+    {
+        auto request = ++numTableRequests;
+        tailLengthSeconds = getTailLength (presetModes);
+
+        tableBuilder.addJob ([this, request, presetToBuild = preset, modesToBuild = presetModes]
+        {
+            if (request == numTableRequests.load())
+                modeTables.publish (std::make_unique<ModeTable> (presetToBuild, modesToBuild, currentSampleRate.load()));
+        });
+    }
+
+    /** Works out how long the slowest mode of the lowest note takes to die
+        away by 60 dB, which is how long the synth can keep sounding after the
+        last note is let go. A lightly damped patch can ring for minutes, so
+        it's capped at a length that a host will sensibly wait for.
+    */
+    static double getTailLength (const ModalPresetModes& modes)
+    {
+        auto lowestFrequency = MidiMessage::getMidiNoteInHertz (0);
+        auto slowestDecayRate = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < ModalPresetModes::numModes; ++i)
+            slowestDecayRate = jmin (slowestDecayRate, (double) modes.dampings[i] * modes.frequencyRatios[i] * lowestFrequency);
+
+        return slowestDecayRate > 0.0 ? jmin (maxTailLengthSeconds, std::log (1000.0) / slowestDecayRate)
+                                      : maxTailLengthSeconds;
+    }
+
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override
+    {
+        // fill a midi buffer with incoming messages from the midi input. It's kept between
+        // blocks, so that a busy controller doesn't make it allocate
+        incomingMidi.clear();
+        midiCollector.removeNextBlockOfMessages (incomingMidi, bufferToFill.numSamples);
+
+        if (midiSource != nullptr)
+            midiSource->addNextBlock (incomingMidi, bufferToFill.numSamples);
+
+        renderNextBlock (bufferToFill, incomingMidi);
+    }
+
+    /** Plays a block of MIDI, along with anything played on the on-screen
+        keyboard, replacing whatever's in the buffer apart from the audio input
+        that the voices can be excited with. Afterwards, the MIDI buffer only
+        holds the messages that went to the synth. The block has to start at
+        the beginning of the buffer.
+    */
+    void renderNextBlock (const AudioSourceChannelInfo& bufferToFill, MidiBuffer& midi)
+    {
+        jassert (bufferToFill.startSample == 0);
+        AudioProcessLoadMeasurer::ScopedTimer timer (loadGovernor.getLoadMeasurer(), bufferToFill.numSamples);
+        ScopedNoDenormals noDenormals;
+        updateVoiceSettings();
+        mixInputForVoices (bufferToFill);
+        auto couplingVoices = prepareVoiceOutputs (bufferToFill.numSamples);
+
+        // the synth always adds its output to the audio buffer, so we have to clear it
+        // first..
+        bufferToFill.clearActiveBufferRegion();
+
+        // pass these messages to the keyboard state so that it can update the component
+        // to show on-screen which keys are being pressed on the physical midi keyboard.
+        // This call will also add midi messages to the buffer which were generated by
+        // the mouse-clicking on the on-screen keyboard. It doesn't lock or call the
+        // component; the keyboard state polls for changes on the message thread.
+        keyboardState.processNextMidiBuffer (midi, 0, bufferToFill.numSamples, true);
+
+        // the expression controllers go straight to the voices, so the synth only sees the notes
+        expression.takeControllers (midi);
+        expression.update (bufferToFill.numSamples);
+
+        // and now get the synth to process the midi events and generate its output.
+        synth.renderNextBlock (*bufferToFill.buffer, midi, 0, bufferToFill.numSamples);
+
+        if (couplingVoices)
+            addSympatheticStrings (*bufferToFill.buffer, bufferToFill.numSamples);
+
+        modeTables.audioBlockFinished();
+    }
+
+    /** Passes the current quality level and stereo width on to the voices, at
+        the start of each block.
+    */
+    void updateVoiceSettings()
+    {
+        loadGovernor.update();
+        auto quality = loadGovernor.getQuality();
+        auto numVoicesAllowed = jmax (1, roundToInt (quality.voiceProportion * synth.getNumVoices()));
+        auto quietModeGain = Decibels::decibelsToGain (quality.quietModeLevelDb, -400.0f);
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+        {
+            auto* voice = (SineWaveVoice*)synth.getVoice(i);
+            voice->setQualityLimits (roundToInt (quality.modeProportion * SineWaveVoice::numModes),
+                                     quietModeGain, i < numVoicesAllowed);
+            voice->setStereoWidth (stereoWidth);
+            voice->setNumPickups (numPickups);
+            voice->setExcitation (excitation);
+        }
+
+        expression.setMPEEnabled (mpeEnabled);
+        sympatheticStringsAllowed = quality.sympatheticStrings;
+    }
+
+    /** Mixes the audio input down to mono for the voices to use as their
+        excitation. The input arrives in the same buffer that the output goes
+        into, so this has to happen before the buffer is cleared.
+    */
+    void mixInputForVoices (const AudioSourceChannelInfo& bufferToFill)
+    {
+        const float* input = nullptr;
+
+        // a block bigger than promised can't be mixed without allocating, so the voices just ring on
+        if (excitation == SineWaveVoice::Excitation::audioInput && bufferToFill.numSamples <= (int) inputScratch.size())
+        {
+            auto* mix = inputScratch.data();
+            FloatVectorOperations::clear (mix, bufferToFill.numSamples);
+
+            for (auto i = 0; i < bufferToFill.buffer->getNumChannels(); ++i)
+                FloatVectorOperations::add (mix, bufferToFill.buffer->getReadPointer (i, bufferToFill.startSample),
+                                            bufferToFill.numSamples);
+
+            input = mix;
+        }
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+            ((SineWaveVoice*)synth.getVoice(i))->setExcitationInput (input);
+    }
+
+    /** Clears a mono buffer for each voice to add its output to, for driving
+        the sympathetic strings, and returns false if they're turned off. When
+        the load governor sheds them, they're run for one more block to fade out.
+    */
+    bool prepareVoiceOutputs (int numSamples)
+    {
+        auto enabled = sympatheticStrings != nullptr && sympatheticLevel > 0.0f
+                        && numSamples <= sympatheticStrings->getMaxBlockSize()
+                        && (sympatheticStringsAllowed || sympatheticStringsRunning);
+
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+        {
+            auto* output = enabled ? voiceOutputs.data() + (size_t) (i * sympatheticStrings->getMaxBlockSize()) : nullptr;
+
+            if (output != nullptr)
+                FloatVectorOperations::clear (output, numSamples);
+
+            ((SineWaveVoice*)synth.getVoice(i))->setCouplingOutput (output);
+        }
+
+        return enabled;
+    }
+
+    /** Runs the voices' output through the sympathetic strings, and adds them
+        equally to every output channel. If they've just been shed, they're
+        faded out over the block and stopped, so they start from silence when
+        they come back.
+    */
+    void addSympatheticStrings (AudioBuffer<float>& buffer, int numSamples)
+    {
+        auto* table = modeTables.get();
+        auto& strings = *sympatheticStrings;
+        const float* sources[maxCouplingVoices] = {};
+
+        for (auto i = 0; i < strings.getMaxSources(); ++i)
+        {
+            sources[i] = voiceOutputs.data() + (size_t) (i * strings.getMaxBlockSize());
+            strings.setSourceNote (i, synth.getVoice (i)->getCurrentlyPlayingNote());
+        }
+
+        auto* mix = inputScratch.data();
+        FloatVectorOperations::clear (mix, numSamples);
+        strings.process (*table, kernelVariant, sources, mix, numSamples, sympatheticLevel);
+
+        for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            if (sympatheticStringsAllowed)
+                buffer.addFrom (channel, 0, mix, numSamples);
+            else
+                buffer.addFromWithRamp (channel, 0, mix, numSamples, 1.0f, 0.0f);
+        }
+
+        if (! sympatheticStringsAllowed)
+            strings.reset();
+
+        sympatheticStringsRunning = sympatheticStringsAllowed;
+    }
+
+    //==============================================================================
+    // this collects real-time midi messages from the midi input device, and
+    // turns them into blocks that we can process in our audio callback
+    MidiMessageCollector midiCollector;
+    MidiBuffer incomingMidi;
+    static constexpr int maxMidiBytesPerBlock = 16384;
+    MidiSource* midiSource = nullptr;
+
+    // this represents the state of which keys on our on-screen keyboard are held
+    // down. When the mouse is clicked on the keyboard component, this object also
+    // generates midi messages for this, which we can pass on to our synth.
+    ModalKeyboardState& keyboardState;
+
+    // the mode frequencies, decay rates and pickup weights for every note,
+    // rebuilt off the audio thread whenever the preset changes
+    SnapshotPublisher<ModeTable> modeTables;
+    ModalPreset preset;     // these two are only used on the message thread
+    ModalPresetModes presetModes { preset };
+    std::atomic<int> numTableRequests { 0 };
+
+    // how far apart the notes are spread across the output channels
+    std::atomic<float> stereoWidth { 0.0f };
+
+    // how many pickups each voice listens to the string with
+    std::atomic<int> numPickups { 1 };
+
+    // whether new notes are plucked, or driven by the audio input or by noise
+    std::atomic<SineWaveVoice::Excitation> excitation { SineWaveVoice::Excitation::pluck };
+    std::vector<float> inputScratch;
+
+    // a few lightly damped strings that ring along with whatever is played near their pitch
+    static constexpr int numSympatheticStrings = 36, lowestSympatheticNote = 36, maxCouplingVoices = 64;
+    std::unique_ptr<ModalSympatheticStrings> sympatheticStrings;
+    std::vector<float> voiceOutputs;
+    std::atomic<float> sympatheticLevel { 0.0f };
+    bool sympatheticStringsAllowed = true, sympatheticStringsRunning = false;    // only used on the audio thread
+    std::atomic<double> currentSampleRate { 44100.0 };
+    std::atomic<size_t> reservedBytes { 0 };       // what the last prepareToPlay() left allocated
+
+    // how long the current preset rings on for after its notes are released
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    static constexpr double maxTailLengthSeconds = 30.0;
+
+    // drops modes and voices when the callback gets close to its deadline
+    ModalLoadGovernor loadGovernor;
+
+    // recently played attacks, which repeated notes can play back instead of
+    // running all of their oscillators
+    ModalAttackCache attackCache;
+
+    // the instruction set the voices' render loops were built for
+    ModalRenderKernels::Variant kernelVariant = ModalRenderKernels::Variant::generic;
+
+    // per-note pitch bend, pressure and timbre, from an MPE controller or ordinary channel messages
+    static constexpr int numVoices = 16;
+    ModalExpression expression { numVoices };
+    std::atomic<bool> mpeEnabled { true };
+
+    // the synth itself!
+    ModalSynthesiser synth;
+
+    // builds the mode tables; this is last so that it's stopped before anything it uses is destroyed
+    ThreadPool tableBuilder { 1 };
+};
+
+//==============================================================================
+class Callback final : public AudioIODeviceCallback
+{
+public:
+    Callback (AudioSourcePlayer& playerIn, LiveScrollingAudioDisplay& displayIn, SynthAudioSource& synthIn,
+              ModalRealtimeProfile& realtimeIn, ModalLatencyMeter& latencyMeterIn)
+        : player (playerIn), display (displayIn), synth (synthIn), realtime (realtimeIn), latencyMeter (latencyMeterIn) {}
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData,
+                                           int numInputChannels,
+                                           float* const* outputChannelData,
+                                           int numOutputChannels,
+                                           int numSamples,
+                                           const AudioIODeviceCallbackContext& context) override
+    {
+        realtime.setUpCurrentThread (0);
+
+        player.audioDeviceIOCallbackWithContext (inputChannelData,
+                                                 numInputChannels,
+                                                 outputChannelData,
+                                                 numOutputChannels,
+                                                 numSamples,
+                                                 context);
+        latencyMeter.process (inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numSamples);
+        display.audioDeviceIOCallbackWithContext (outputChannelData,
+                                                  numOutputChannels,
+                                                  nullptr,
+                                                  0,
+                                                  numSamples,
+                                                  context);
+    }
+
+    void audioDeviceAboutToStart (AudioIODevice* device) override
+    {
+        player.audioDeviceAboutToStart (device);
+        display.audioDeviceAboutToStart (device);
+        latencyMeter.prepare (device->getCurrentSampleRate(), device->getOutputLatencyInSamples());
+
+        // the synth has just been prepared, so everything it'll use has been allocated by now
+        if (realtime.isEnabled())
+            synth.prefaultMemory();
+    }
+
+    void audioDeviceStopped() override
+    {
+        player.audioDeviceStopped();
+        display.audioDeviceStopped();
+    }
+
+private:
+    AudioSourcePlayer& player;
+    LiveScrollingAudioDisplay& display;
+    SynthAudioSource& synth;
+    ModalRealtimeProfile& realtime;
+    ModalLatencyMeter& latencyMeter;
+};
+
+//==============================================================================
+class AudioSynthesiserDemo final : public Component,
+                                   private Timer
+{
+public:
+    AudioSynthesiserDemo()
+    {
+        addAndMakeVisible (keyboardComponent);
+
+        addAndMakeVisible (sineButton);
+        sineButton.setRadioGroupId (321);
+        sineButton.setToggleState (true, dontSendNotification);
+        sineButton.onClick = [this] { synthAudioSource.setUsingSineWaveSound(); };
+
+        addAndMakeVisible (attackCacheButton);
+        attackCacheButton.onClick = [this] { synthAudioSource.attackCache.setEnabled (attackCacheButton.getToggleState()); };
+
+        addAndMakeVisible (presetBox);
+
+        auto presetId = 1;
+
+        for (auto& factoryPreset : ModalPreset::getFactoryPresets())
+            presetBox.addItem (factoryPreset.name, presetId++);
+
+        presetBox.setSelectedId (1, dontSendNotification);
+        presetBox.onChange = [this] { presetChanged(); };
+
+        addAndMakeVisible (loadBankButton);
+        loadBankButton.onClick = [this] { chooseBank(); };
+
+        addAndMakeVisible (mpeButton);
+        mpeButton.setToggleState (true, dontSendNotification);
+        mpeButton.onClick = [this] { synthAudioSource.mpeEnabled = mpeButton.getToggleState(); };
+
+        addAndMakeVisible (stereoPickupsButton);
+        stereoPickupsButton.onClick = [this] { synthAudioSource.numPickups = stereoPickupsButton.getToggleState() ? 2 : 1; };
+
+        addAndMakeVisible (excitationBox);
+        excitationBox.addItemList ({ "Pluck", "Excite from audio input", "Bowed (noise)" }, 1);
+        excitationBox.setSelectedId (1, dontSendNotification);
+        excitationBox.onChange = [this] { synthAudioSource.excitation = (SineWaveVoice::Excitation) (excitationBox.getSelectedId() - 1); };
+
+        addAndMakeVisible (realtimeButton);
+        realtimeButton.onClick = [this] { realtimeChanged(); };
+
+        addAndMakeVisible (liveAudioDisplayComp);
+        addAndMakeVisible (loadLabel);
+        addAndMakeVisible (realtimeLabel);
+        realtimeLabel.setJustificationType (Justification::topLeft);
+
+        addAndMakeVisible (latencyBox);
+        latencyBox.addItemList ({ "No latency measurement", "Round trip (MLS)", "Round trip (chirp)", "MIDI to audio" }, 1);
+        latencyBox.setSelectedId (1, dontSendNotification);
+        latencyBox.onChange = [this] { latencyModeChanged(); };
+
+        addAndMakeVisible (latencyLabel);
+        latencyLabel.setJustificationType (Justification::topLeft);
+        
+        addAndMakeVisible (stiffness);
+        stiffness.setRange (0.0f, 2.0f);
+        stiffness.addListener(&synthAudioSource);
+        stiffness.setComponentID("stiffness");
+        
+        addAndMakeVisible (pluckPos);
+        pluckPos.setRange (0.01f, PI-0.01f);
+        pluckPos.addListener(&synthAudioSource);
+        pluckPos.setComponentID("pluckPos");
+        
+        addAndMakeVisible (pickupPos);
+        pickupPos.setRange (0.01f, PI-0.01f);
+        pickupPos.addListener(&synthAudioSource);
+        pickupPos.setComponentID("pickupPos");
+
+        addAndMakeVisible (secondPickupPos);
+        secondPickupPos.setRange (0.01f, PI-0.01f);
+        secondPickupPos.addListener(&synthAudioSource);
+        secondPickupPos.setComponentID("secondPickupPos");
+
+        addAndMakeVisible (stereoWidth);
+        stereoWidth.setRange (0.0f, 1.0f);
+        stereoWidth.addListener(&synthAudioSource);
+        stereoWidth.setComponentID("stereoWidth");
+        showPresetValues (synthAudioSource.getPreset());
+
+        addAndMakeVisible (sympatheticLevel);
+        sympatheticLevel.setRange (0.0f, 1.0f);
+        sympatheticLevel.addListener(&synthAudioSource);
+        sympatheticLevel.setComponentID("sympathetic");
+        //openAttachment.reset (new SliderAttachment (valueTreeState, "open_amount", openAmountSlider.slider));
+        
+        
+        
+        audioSourcePlayer.setSource (&synthAudioSource);
+
+       #ifndef JUCE_DEMO_RUNNER
+        audioDeviceManager.initialise (2, 2, nullptr, true, {}, nullptr);
+       #endif
+
+        audioDeviceManager.addAudioCallback (&callback);
+        audioDeviceManager.addMidiInputDeviceCallback ({}, &(synthAudioSource.midiCollector));
+
+        setOpaque (true);
+        setSize (640, 480);
+        startTimerHz (4);
+    }
+
+    ~AudioSynthesiserDemo() override
+    {
+        audioSourcePlayer.setSource (nullptr);
+        audioDeviceManager.removeMidiInputDeviceCallback ({}, &(synthAudioSource.midiCollector));
+        audioDeviceManager.removeAudioCallback (&callback);
+    }
+
+    //==============================================================================
+    void paint (Graphics& g) override
+    {
+        g.fillAll (getUIColourIfAvailable (LookAndFeel_V4::ColourScheme::UIColour::windowBackground));
+    }
+
+    void resized() override
+    {
+        keyboardComponent   .setBounds (8, 96, getWidth() - 16, 64);
+        stiffness    .setBounds (8, 256, 120, 120);
+        pluckPos    .setBounds (132, 256, 120, 120);
+        pickupPos    .setBounds (256, 256, 120, 120);
+        secondPickupPos.setBounds (380, 256, 120, 120);
+        stereoWidth  .setBounds (504, 256, 120, 120);
+        sympatheticLevel.setBounds (8, 380, 120, 90);
+        sineButton          .setBounds (16, 176, 150, 24);
+        sampledButton       .setBounds (16, 200, 150, 24);
+        attackCacheButton   .setBounds (176, 176, 150, 24);
+        stereoPickupsButton .setBounds (176, 200, 150, 24);
+        mpeButton           .setBounds (16, 225, 150, 24);
+        excitationBox       .setBounds (176, 226, 200, 22);
+        presetBox           .setBounds (384, 226, 200, 22);
+        loadBankButton      .setBounds (588, 226, 44, 22);
+        loadLabel           .setBounds (336, 176, getWidth() - 344, 24);
+        realtimeButton      .setBounds (136, 384, 150, 24);
+        realtimeLabel       .setBounds (136, 408, 240, 64);
+        latencyBox          .setBounds (384, 384, 200, 22);
+        latencyLabel        .setBounds (384, 408, getWidth() - 392, 64);
+        liveAudioDisplayComp.setBounds (8, 8, getWidth() - 16, 64);
+    }
+
+private:
+    void presetChanged()
+    {
+        auto id = presetBox.getSelectedId();
+        auto& factoryPresets = ModalPreset::getFactoryPresets();
+
+        if (isPositiveAndBelow (id - 1, (int) factoryPresets.size()))
+        {
+            auto& newPreset = factoryPresets[(size_t) id - 1];
+            synthAudioSource.loadPreset (newPreset);
+            showPresetValues (newPreset);
+        }
+        else if (isPositiveAndBelow (id - firstBankPresetId, presetBank.getNumPresets()))
+        {
+            if (auto entry = presetBank.getPreset (id - firstBankPresetId))
+            {
+                synthAudioSource.loadPreset (entry->preset, entry->modes);
+                showPresetValues (entry->preset);
+            }
+            else
+            {
+                AlertWindow::showMessageBoxAsync (MessageBoxIconType::WarningIcon, "Damaged preset",
+                                                  presetBank.getName (id - firstBankPresetId) + " doesn't match its checksum.");
+            }
+        }
+    }
+
+    /** Turns the real-time profile on or off, and restarts the device so that
+        the synth's memory is pre-faulted and the audio thread picks it up.
+    */
+    void realtimeChanged()
+    {
+        realtime.setEnabled (realtimeButton.getToggleState());
+        audioDeviceManager.closeAudioDevice();
+        audioDeviceManager.restartLastAudioDevice();
+    }
+
+    /** Starts or stops measuring latency. The round trip needs the outputs
+        looped back to the first input, and replaces the synth while it runs.
+    */
+    void latencyModeChanged()
+    {
+        switch (latencyBox.getSelectedId())
+        {
+            case 2:  latencyMeter.start (ModalLatencyMeter::Mode::roundTrip, ModalLatencyMeter::Signal::mls); break;
+            case 3:  latencyMeter.start (ModalLatencyMeter::Mode::roundTrip, ModalLatencyMeter::Signal::chirp); break;
+
+            case 4:
+                latencyMeter.start (ModalLatencyMeter::Mode::midiToAudio, ModalLatencyMeter::Signal::mls, [this] (bool isNoteOn)
+                {
+                    if (isNoteOn)
+                        keyboardState.noteOn (1, 69, 0.8f);
+                    else
+                        keyboardState.noteOff (1, 69, 0.0f);
+                });
+                break;
+
+            default: latencyMeter.stop(); break;
+        }
+    }
+
+    /** Asks for a preset bank, and adds its presets to the list after the factory ones. */
+    void chooseBank()
+    {
+        bankChooser = std::make_unique<FileChooser> ("Open a preset bank", File(), "*.mpbank");
+
+        bankChooser->launchAsync (FileBrowserComponent::openMode | FileBrowserComponent::canSelectFiles, [this] (const FileChooser& chooser)
+        {
+            auto file = chooser.getResult();
+
+            if (file == File())
+                return;
+
+            if (auto result = presetBank.open (file); result.failed())
+            {
+                AlertWindow::showMessageBoxAsync (MessageBoxIconType::WarningIcon, "Couldn't open the bank", result.getErrorMessage());
+                return;
+            }
+
+            presetBox.clear (dontSendNotification);
+            auto presetId = 1;
+
+            for (auto& factoryPreset : ModalPreset::getFactoryPresets())
+                presetBox.addItem (factoryPreset.name, presetId++);
+
+            presetBox.addSeparator();
+
+            for (int i = 0; i < presetBank.getNumPresets(); ++i)
+                presetBox.addItem (presetBank.getName (i), firstBankPresetId + i);
+        });
+    }
+
+    void showPresetValues (const ModalPreset& presetToShow)
+    {
+        stiffness      .setValue (presetToShow.stiffness, dontSendNotification);
+        pluckPos       .setValue (presetToShow.pluckPos, dontSendNotification);
+        pickupPos      .setValue (presetToShow.pickupPositions[0], dontSendNotification);
+        secondPickupPos.setValue (presetToShow.pickupPositions[1], dontSendNotification);
+    }
+
+    void timerCallback() override
+    {
+        synthAudioSource.modeTables.collectGarbage();
+
+        auto& governor = synthAudioSource.loadGovernor;
+        loadLabel.setText ("CPU " + String (roundToInt (governor.getLoad() * 100.0)) + "%, quality reduction "
+                             + String (governor.getLevel()) + "/" + String (ModalLoadGovernor::numLevels - 1)
+                             + ", " + File::descriptionOfSizeInBytes ((int64) synthAudioSource.reservedBytes.load()) + " reserved",
+                           dontSendNotification);
+
+        realtimeLabel.setText (realtime.getReport(), dontSendNotification);
+        latencyLabel.setText (latencyMeter.getReport(), dontSendNotification);
+    }
+
+    // if this PIP is running inside the demo runner, we'll use the shared device manager instead
+   #ifndef JUCE_DEMO_RUNNER
+    AudioDeviceManager audioDeviceManager;
+   #else
+    AudioDeviceManager& audioDeviceManager { getSharedAudioDeviceManager (2, 2) };
+   #endif
+
+    ModalKeyboardState keyboardState;
+    AudioSourcePlayer audioSourcePlayer;
+    SynthAudioSource synthAudioSource        { keyboardState };
+    MidiKeyboardComponent keyboardComponent  { keyboardState.getDisplayState(), MidiKeyboardComponent::horizontalKeyboard};
+
+    ToggleButton sineButton     { "Use sine wave" };
+    ToggleButton sampledButton  { "Use sampled sound" };
+    ToggleButton attackCacheButton { "Cache note attacks" };
+    ToggleButton stereoPickupsButton { "Stereo pickups" };
+    ToggleButton mpeButton { "MPE" };
+    ToggleButton realtimeButton { "Real-time profile" };
+    ComboBox excitationBox;
+    ComboBox latencyBox;
+    ComboBox presetBox;
+    TextButton loadBankButton { "Bank" };
+    ModalPresetBank presetBank;
+    std::unique_ptr<FileChooser> bankChooser;
+    static constexpr int firstBankPresetId = 1000;
+    Label loadLabel, realtimeLabel, latencyLabel;
+    
+    Slider stiffness {"stiffness"};
+    Slider pluckPos {"pluck pos"};
+    Slider pickupPos {"pickup pos"};
+    Slider secondPickupPos {"second pickup pos"};
+    Slider stereoWidth {"stereo width"};
+    Slider sympatheticLevel {"sympathetic"};
+    
+    LiveScrollingAudioDisplay liveAudioDisplayComp;
+
+    ModalRealtimeProfile realtime;
+    ModalLatencyMeter latencyMeter;
+    Callback callback { audioSourcePlayer, liveAudioDisplayComp, synthAudioSource, realtime, latencyMeter };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioSynthesiserDemo)
+};
+
+
+
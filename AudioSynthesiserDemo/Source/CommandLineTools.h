@@ -0,0 +1,618 @@
+/*
+  ==============================================================================
+
+    Headless tools that can be run from the command line instead of opening
+    the synth window, e.g.
+
+        AudioSynthesiserDemo --export --output=~/samples --notes=36-96 --note-step=3
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "SampleLibraryExporter.h"
+#include "ModalBenchmarks.h"
+#include "ModalAnalyser.h"
+#include "ModalSynthProcessor.h"
+#include "ModalEffects.h"
+#include "ModalGraphHost.h"
+#include "ModalLoopbackDevice.h"
+#include "ModalLatencyMeter.h"
+
+//==============================================================================
+namespace CommandLineTools
+{
+    inline Array<float> getFloatListOption (const ArgumentList& args, StringRef option, Array<float> defaultValues)
+    {
+        auto text = args.getValueForOption (option);
+
+        if (text.isEmpty())
+            return defaultValues;
+
+        Array<float> values;
+
+        for (auto& token : StringArray::fromTokens (text, ",", {}))
+            values.add (token.getFloatValue());
+
+        return values;
+    }
+
+    inline Array<int> getNoteRangeOption (const ArgumentList& args, StringRef option, int step)
+    {
+        auto text = args.getValueForOption (option);
+
+        if (text.isEmpty())
+            text = "21-108";
+
+        auto lowest  = jlimit (0, 127, text.upToFirstOccurrenceOf ("-", false, false).getIntValue());
+        auto highest = jlimit (0, 127, text.containsChar ('-') ? text.fromFirstOccurrenceOf ("-", false, false).getIntValue()
+                                                              : lowest);
+        Array<int> notes;
+
+        for (auto note = lowest; note <= highest; note += jmax (1, step))
+            notes.add (note);
+
+        return notes;
+    }
+
+    inline void runSampleExport (const ArgumentList& args)
+    {
+        args.failIfOptionIsMissing ("--output");
+
+        SampleLibraryExporter::Options options;
+        options.outputFolder       = args.getFileForOption ("--output");
+        options.notes              = getNoteRangeOption (args, "--notes", args.getValueForOption ("--note-step").getIntValue());
+        options.velocities         = getFloatListOption (args, "--velocities", options.velocities);
+        options.stiffnesses        = getFloatListOption (args, "--stiffness", options.stiffnesses);
+        options.pluckPositions     = getFloatListOption (args, "--pluck", options.pluckPositions);
+        options.pickupPositions    = getFloatListOption (args, "--pickup", options.pickupPositions);
+        options.useFlac            = args.getValueForOption ("--format").equalsIgnoreCase ("flac");
+
+        if (args.containsOption ("--rate"))         options.sampleRate         = args.getValueForOption ("--rate").getDoubleValue();
+        if (args.containsOption ("--channels"))     options.numChannels        = args.getValueForOption ("--channels").getIntValue();
+        if (args.containsOption ("--bits"))         options.bitsPerSample      = args.getValueForOption ("--bits").getIntValue();
+        if (args.containsOption ("--threads"))      options.numThreads         = args.getValueForOption ("--threads").getIntValue();
+        if (args.containsOption ("--silence"))      options.silenceThresholdDb = args.getValueForOption ("--silence").getFloatValue();
+        if (args.containsOption ("--max-length"))   options.maxSecondsPerNote  = args.getValueForOption ("--max-length").getDoubleValue();
+        if (args.containsOption ("--start"))        options.startSeconds       = args.getValueForOption ("--start").getDoubleValue();
+
+        SampleLibraryExporter exporter (options);
+
+        if (exporter.run() > 0)
+            ConsoleApplication::fail ("Some notes failed to render");
+    }
+
+    inline void runMakeBank (const ArgumentList& args)
+    {
+        args.failIfOptionIsMissing ("--input");
+        args.failIfOptionIsMissing ("--output");
+
+        std::vector<ModalPresetBank::Entry> entries;
+
+        for (auto& input : StringArray::fromTokens (args.getValueForOption ("--input"), ",", {}))
+        {
+            auto file = File::getCurrentWorkingDirectory().getChildFile (input.unquoted());
+
+            if (auto result = ModalPresetBank::readPresetList (file, entries); result.failed())
+                ConsoleApplication::fail (file.getFullPathName() + ": " + result.getErrorMessage());
+        }
+
+        auto output = args.getFileForOption ("--output");
+
+        if (auto result = ModalPresetBank::write (output, entries); result.failed())
+            ConsoleApplication::fail (result.getErrorMessage());
+
+        std::cout << "Wrote " << (int) entries.size() << " presets to " << output.getFullPathName() << std::endl;
+    }
+
+    inline void runAnalysis (const ArgumentList& args)
+    {
+        args.failIfOptionIsMissing ("--input");
+        args.failIfOptionIsMissing ("--output");
+
+        ModalAnalyser::Options options;
+
+        if (args.containsOption ("--note"))         options.midiNote   = args.getValueForOption ("--note").getIntValue();
+        if (args.containsOption ("--fft-order"))    options.fftOrder   = args.getValueForOption ("--fft-order").getIntValue();
+        if (args.containsOption ("--modes"))        options.maxModes   = args.getValueForOption ("--modes").getIntValue();
+        if (args.containsOption ("--seconds"))      options.maxSeconds = args.getValueForOption ("--seconds").getDoubleValue();
+
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        // folders are expanded to all the audio files in them, and anything else is a file or demo asset
+        StringArray inputs;
+
+        for (auto& input : StringArray::fromTokens (args.getValueForOption ("--input"), ",", {}))
+        {
+            auto folder = File::getCurrentWorkingDirectory().getChildFile (input.unquoted());
+
+            if (folder.isDirectory())
+            {
+                for (auto& file : folder.findChildFiles (File::findFiles, false, formatManager.getWildcardForAllFormats()))
+                    inputs.add (file.getFullPathName());
+            }
+            else
+            {
+                inputs.add (input.unquoted());
+            }
+        }
+
+        inputs.sort (true);
+        std::vector<std::unique_ptr<AudioFormatReader>> readers;
+
+        for (auto& input : inputs)
+        {
+            readers.push_back (ModalAnalyser::createReader (formatManager, input));
+
+            if (readers.back() == nullptr)
+                ConsoleApplication::fail ("Couldn't open " + input);
+        }
+
+        auto numThreads = args.containsOption ("--threads") ? args.getValueForOption ("--threads").getIntValue()
+                                                            : SystemStats::getNumCpus();
+        ThreadPool pool (jmax (1, numThreads));
+        ModalAnalyser analyser (options, &pool);
+
+        std::vector<ModalAnalyser::Analysis> analyses (readers.size());
+        std::vector<Result> results (readers.size(), Result::ok());
+
+        // each file is one item, and each of those spreads its own frames across the same pool
+        auto ms = ModalBenchmarks::timeMs ([&]
+        {
+            analyser.parallelFor ((int) readers.size(), [&] (int i)
+            {
+                auto name = File::createFileWithoutCheckingPath (inputs[i]).getFileNameWithoutExtension();
+                results[(size_t) i] = analyser.analyse (*readers[(size_t) i], name, analyses[(size_t) i]);
+            });
+        });
+
+        std::vector<ModalPresetBank::Entry> entries;
+
+        for (size_t i = 0; i < analyses.size(); ++i)
+        {
+            if (results[i].failed())
+            {
+                std::cout << results[i].getErrorMessage() << std::endl;
+                continue;
+            }
+
+            auto& analysis = analyses[i];
+            std::cout << analysis.entry.preset.name << ": " << (int) analysis.partials.size() << " partials over "
+                      << analysis.numFrames << " frames, fundamental " << String (analysis.fundamental, 1) << " Hz" << std::endl;
+
+            entries.push_back (analysis.entry);
+        }
+
+        std::cout << "Analysed " << (int) readers.size() << " files in " << String (ms, 1) << " ms on "
+                  << pool.getNumThreads() << " threads" << std::endl;
+
+        if (entries.empty())
+            ConsoleApplication::fail ("Nothing was analysed");
+
+        auto output = args.getFileForOption ("--output");
+        auto result = output.hasFileExtension ("mpbank") ? ModalPresetBank::write (output, entries)
+                                                         : ModalPresetBank::writePresetList (output, entries);
+
+        if (result.failed())
+            ConsoleApplication::fail (result.getErrorMessage());
+
+        if (entries.size() < readers.size())
+            ConsoleApplication::fail ("Some files couldn't be analysed");
+    }
+
+    //==============================================================================
+    /** Plays a number of synths, each through its own chain of effects, into a
+        shared master limiter, as fast as the graph host can render them.
+    */
+    inline void runGraph (const ArgumentList& args)
+    {
+        auto getIntOption = [&] (StringRef option, int defaultValue)
+        {
+            return args.containsOption (option) ? args.getValueForOption (option).getIntValue() : defaultValue;
+        };
+
+        auto numChains  = jmax (1, getIntOption ("--chains", 16));
+        auto numEffects = jmax (0, getIntOption ("--effects", 2));
+        auto numThreads = jmax (1, getIntOption ("--threads", SystemStats::getNumCpus()));
+        auto blockSize  = jmax (1, getIntOption ("--block", 256));
+        auto sampleRate = args.containsOption ("--rate") ? args.getValueForOption ("--rate").getDoubleValue() : 48000.0;
+        auto seconds    = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 10.0;
+
+        ModalGraphHost host (numThreads);
+        std::vector<int> chains;
+
+        // --realtime on its own uses the isolated cores, or it can be given a list like --realtime=2-5
+        ModalRealtimeProfile realtime;
+
+        if (args.containsOption ("--realtime"))
+        {
+            realtime.setEnabled (true, getIntOption ("--priority", 70), args.getValueForOption ("--realtime"));
+            host.setRealtimeProfile (&realtime);
+        }
+
+        for (int i = 0; i < numChains; ++i)
+        {
+            std::vector<std::unique_ptr<AudioProcessor>> processors;
+            processors.push_back (std::make_unique<ModalSynthProcessor>());
+
+            // alternating the effects means the chains have different latencies to line up
+            for (int j = 0; j < numEffects; ++j)
+            {
+                if ((i + j) % 2 == 0)
+                    processors.push_back (std::make_unique<ModalDelayEffect> (0.1 + 0.02 * i));
+                else
+                    processors.push_back (std::make_unique<ModalLimiterEffect> (0.001 * (1 + i % 5)));
+            }
+
+            chains.push_back (host.addNode (ModalGraphHost::createChain (std::move (processors)), "chain " + String (i + 1)));
+        }
+
+        host.addNode (std::make_unique<ModalLimiterEffect>(), "master", chains);
+        host.prepare (sampleRate, blockSize, 2);
+
+        // each chain plays its own note over and over, starting at a different time
+        auto noteLength = roundToInt (0.4 * sampleRate);
+        std::vector<int> nextEventSamples, notes;
+        std::vector<bool> notesAreOn ((size_t) numChains, false);
+
+        for (int i = 0; i < numChains; ++i)
+        {
+            nextEventSamples.push_back (roundToInt (0.05 * i * sampleRate));
+            notes.push_back (36 + (i * 7) % 48);
+        }
+
+        AudioBuffer<float> output (2, blockSize);
+        auto numBlocks = jmax (1, roundToInt (seconds * sampleRate / blockSize));
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            auto blockStart = block * blockSize;
+
+            for (size_t i = 0; i < chains.size(); ++i)
+            {
+                while (nextEventSamples[i] < blockStart + blockSize)
+                {
+                    auto position = nextEventSamples[i] - blockStart;
+                    auto& midi = host.getMidiBuffer (chains[i]);
+
+                    if (notesAreOn[i])
+                    {
+                        midi.addEvent (MidiMessage::noteOff (1, notes[i]), position);
+                        nextEventSamples[i] += noteLength / 2 + (int) i * blockSize;
+                    }
+                    else
+                    {
+                        midi.addEvent (MidiMessage::noteOn (1, notes[i], 0.8f), position);
+                        nextEventSamples[i] += noteLength;
+                    }
+
+                    notesAreOn[i] = ! notesAreOn[i];
+                }
+            }
+
+            host.process (output, blockSize);
+        }
+
+        host.releaseResources();
+
+        std::cout << numChains << " chains of a synth and " << numEffects << " effects into a master limiter, "
+                  << blockSize << " sample blocks at " << String (sampleRate, 0) << " Hz" << std::endl
+                  << std::endl << host.getReport();
+
+        if (realtime.isEnabled())
+            std::cout << std::endl << realtime.getReport();
+    }
+
+    //==============================================================================
+    /** Plays notes at fixed sample positions, so that a run through the
+        loopback device plays the same notes at the same times every time.
+    */
+    struct ScheduledNotes final : public SynthAudioSource::MidiSource
+    {
+        ScheduledNotes (double notesPerSecondToUse, double holdSecondsToUse)
+            : notesPerSecond (jmax (0.01, notesPerSecondToUse)), holdSeconds (jmax (0.01, holdSecondsToUse))
+        {
+        }
+
+        void prepareToPlay (double newSampleRate) override
+        {
+            sampleRate = newSampleRate;
+            position = 0;
+            nextNote = nextRelease = 0;
+        }
+
+        // the notes go into the synth's own MIDI for the block, each at its exact sample
+        void addNextBlock (MidiBuffer& midi, int numSamples) override
+        {
+            auto blockEnd = position + numSamples;
+
+            for (; getNoteStart (nextNote) < blockEnd; ++nextNote)
+                midi.addEvent (MidiMessage::noteOn (1, getNoteNumber (nextNote), 0.8f), (int) (getNoteStart (nextNote) - position));
+
+            for (; nextRelease < nextNote && getNoteEnd (nextRelease) < blockEnd; ++nextRelease)
+                midi.addEvent (MidiMessage::noteOff (1, getNoteNumber (nextRelease)), (int) (getNoteEnd (nextRelease) - position));
+
+            position = blockEnd;
+        }
+
+        int64 getNoteStart (int index) const noexcept       { return (int64) (index * sampleRate / notesPerSecond); }
+        int64 getNoteEnd (int index) const noexcept         { return getNoteStart (index) + roundToInt (holdSeconds * sampleRate); }
+        static int getNoteNumber (int index) noexcept       { return 36 + (index * 7) % 48; }
+
+        const double notesPerSecond, holdSeconds;
+        double sampleRate = 48000.0;
+        int64 position = 0;
+        int nextNote = 0, nextRelease = 0;
+    };
+
+    /** The same chain of audio callbacks that the demo's window runs. */
+    struct HeadlessChain
+    {
+        HeadlessChain()     { player.setSource (&synthSource); }
+        ~HeadlessChain()    { player.setSource (nullptr); }
+
+        ModalKeyboardState keyboardState;
+        SynthAudioSource synthSource { keyboardState };
+        AudioSourcePlayer player;
+        LiveScrollingAudioDisplay display;
+        ModalRealtimeProfile realtime;
+        ModalLatencyMeter latencyMeter;
+        Callback callback { player, display, synthSource, realtime, latencyMeter };
+    };
+
+    inline double getDoubleOption (const ArgumentList& args, StringRef option, double defaultValue)
+    {
+        return args.containsOption (option) ? args.getValueForOption (option).getDoubleValue() : defaultValue;
+    }
+
+    inline ModalLoopbackDevice::Settings getLoopbackSettings (const ArgumentList& args)
+    {
+        ModalLoopbackDevice::Settings settings;
+        settings.sampleRate        = getDoubleOption (args, "--rate", settings.sampleRate);
+        settings.blockSize         = jmax (1, roundToInt (getDoubleOption (args, "--block", settings.blockSize)));
+        settings.numInputChannels  = jmax (0, roundToInt (getDoubleOption (args, "--inputs", settings.numInputChannels)));
+        settings.numOutputChannels = jmax (1, roundToInt (getDoubleOption (args, "--outputs", settings.numOutputChannels)));
+        settings.latencySamples    = jmax (0, roundToInt (getDoubleOption (args, "--latency", 0)));
+        settings.realTime          = ! args.containsOption ("--fast");
+        settings.captureSeconds    = jmax (0.1, getDoubleOption (args, "--seconds", 10.0));
+        return settings;
+    }
+
+    /** Opens the loopback device with all its channels, or stops with an error. */
+    inline ModalLoopbackDevice& openLoopbackDevice (AudioDeviceManager& deviceManager, const ModalLoopbackDevice::Settings& settings)
+    {
+        deviceManager.addAudioDeviceType (std::make_unique<ModalLoopbackDeviceType> (settings));
+        deviceManager.setCurrentAudioDeviceType (ModalLoopbackDevice::loopbackTypeName, true);
+
+        AudioDeviceManager::AudioDeviceSetup setup;
+        setup.outputDeviceName = setup.inputDeviceName = ModalLoopbackDeviceType::deviceName;
+        setup.sampleRate = settings.sampleRate;
+        setup.bufferSize = settings.blockSize;
+        setup.inputChannels.setRange (0, settings.numInputChannels, true);
+        setup.outputChannels.setRange (0, settings.numOutputChannels, true);
+        setup.useDefaultInputChannels = setup.useDefaultOutputChannels = false;
+
+        auto error = deviceManager.setAudioDeviceSetup (setup, true);
+        auto* device = dynamic_cast<ModalLoopbackDevice*> (deviceManager.getCurrentAudioDevice());
+
+        if (error.isNotEmpty() || device == nullptr)
+            ConsoleApplication::fail ("Couldn't open the loopback device: " + error);
+
+        return *device;
+    }
+
+    /** Runs the demo's whole callback chain on the loopback device, with no
+        window or sound card, and reports how long the callbacks took.
+    */
+    inline void runLoopback (const ArgumentList& args)
+    {
+        auto settings = getLoopbackSettings (args);
+        HeadlessChain chain;
+        ScheduledNotes notes (getDoubleOption (args, "--notes-per-second", 4.0), getDoubleOption (args, "--hold", 1.0));
+        chain.synthSource.setMidiSource (&notes);
+        auto& realtime = chain.realtime;
+
+        if (args.containsOption ("--realtime"))
+            realtime.setEnabled (true, 70, args.getValueForOption ("--realtime"));
+
+        AudioDeviceManager deviceManager;
+        auto& device = openLoopbackDevice (deviceManager, settings);
+        deviceManager.addAudioCallback (&chain.callback);
+
+        // the device runs on its own thread, so this just has to wait until it's rendered enough
+        while (device.getNumCapturedSamples() < device.getCaptureLength())
+            Thread::sleep (settings.realTime ? 50 : 5);
+
+        device.stop();
+        std::cout << (settings.realTime ? "Real time, " : "As fast as possible, ") << settings.blockSize << " sample blocks at "
+                  << String (settings.sampleRate, 0) << " Hz" << std::endl
+                  << std::endl << device.getStats().getReport (device.getCurrentSampleRate());
+
+        if (realtime.isEnabled())
+            std::cout << std::endl << realtime.getReport();
+
+        // enough to spot a change in what's rendered between runs of the same settings
+        auto& captured = device.getCapturedOutput();
+        auto numCaptured = device.getNumCapturedSamples();
+        float peak = 0.0f;
+        double sumOfSquares = 0.0;
+
+        for (int channel = 0; channel < captured.getNumChannels(); ++channel)
+        {
+            peak = jmax (peak, captured.getMagnitude (channel, 0, numCaptured));
+            auto rms = (double) captured.getRMSLevel (channel, 0, numCaptured);
+            sumOfSquares += rms * rms;
+        }
+
+        std::cout << std::endl << "Output: peak " << String (Decibels::gainToDecibels (peak), 2) << " dB, RMS "
+                  << String (Decibels::gainToDecibels ((float) std::sqrt (sumOfSquares / jmax (1, captured.getNumChannels()))), 2)
+                  << " dB over " << numCaptured << " samples" << std::endl;
+
+        if (args.containsOption ("--output"))
+        {
+            auto file = args.getFileForOption ("--output");
+            file.deleteFile();
+
+            WavAudioFormat wav;
+            auto stream = std::make_unique<FileOutputStream> (file);
+
+            if (stream->failedToOpen())
+                ConsoleApplication::fail ("Couldn't write to " + file.getFullPathName());
+
+            std::unique_ptr<AudioFormatWriter> writer (wav.createWriterFor (stream.get(), device.getCurrentSampleRate(),
+                                                                            (unsigned int) captured.getNumChannels(), 24, {}, 0));
+            if (writer == nullptr)
+                ConsoleApplication::fail ("Couldn't write to " + file.getFullPathName());
+
+            stream.release(); // the writer owns the stream now
+            writer->writeFromAudioSampleBuffer (captured, 0, numCaptured);
+        }
+
+        deviceManager.removeAudioCallback (&chain.callback);
+        deviceManager.closeAudioDevice();
+    }
+
+    /** Measures the round trip through the loopback device, which should come
+        to exactly one block plus the device's latency, and then the time from
+        a note on the keyboard to the synth's first sample.
+    */
+    inline void runLatencyTest (const ArgumentList& args)
+    {
+        auto settings = getLoopbackSettings (args);
+        settings.captureSeconds = 0.1;
+        auto seconds = jmax (1.0, getDoubleOption (args, "--seconds", 5.0));
+        auto signal = args.getValueForOption ("--signal").equalsIgnoreCase ("chirp") ? ModalLatencyMeter::Signal::chirp
+                                                                                       : ModalLatencyMeter::Signal::mls;
+        HeadlessChain chain;
+        auto& meter = chain.latencyMeter;
+
+        AudioDeviceManager deviceManager;
+        openLoopbackDevice (deviceManager, settings);
+        deviceManager.addAudioCallback (&chain.callback);
+
+        meter.start (ModalLatencyMeter::Mode::roundTrip, signal);
+        Thread::sleep (roundToInt (seconds * 1000.0));
+        meter.stop();
+        auto roundTrip = meter.getRoundTripSummary();
+        std::cout << meter.getReport();
+
+        meter.start (ModalLatencyMeter::Mode::midiToAudio, signal, [&chain] (bool isNoteOn)
+        {
+            if (isNoteOn)
+                chain.keyboardState.noteOn (1, 69, 0.8f);
+            else
+                chain.keyboardState.noteOff (1, 69, 0.0f);
+        });
+
+        Thread::sleep (roundToInt (seconds * 1000.0));
+        meter.stop();
+        auto midi = meter.getMidiSummary();
+        std::cout << meter.getReport();
+
+        deviceManager.removeAudioCallback (&chain.callback);
+        deviceManager.closeAudioDevice();
+
+        auto expected = (double) (settings.blockSize + settings.latencySamples);
+
+        if (roundTrip.count == 0)
+            ConsoleApplication::fail ("No round trips were measured");
+
+        if (std::abs (roundTrip.minimum - expected) > 0.01 || std::abs (roundTrip.maximum - expected) > 0.01)
+            ConsoleApplication::fail ("Expected a round trip of " + String (expected, 0) + " samples");
+
+        if (settings.realTime && midi.count == 0)
+            ConsoleApplication::fail ("No notes were heard");
+    }
+
+    //==============================================================================
+    /** Returns true if the command line asks for one of the headless tools. */
+    inline bool isHeadlessCommand (const StringArray& args)
+    {
+        return args.size() > 0 && args[0].startsWith ("--");
+    }
+
+    inline int run (const StringArray& commandLineArgs)
+    {
+        ConsoleApplication app;
+
+        app.addHelpCommand ("--help|-h", "Usage:", false);
+
+        app.addCommand ({ "--export",
+                          "--export --output=<folder> [--notes=21-108] [--note-step=1] [--velocities=0.5,1] "
+                          "[--stiffness=0] [--pluck=0.2] [--pickup=0.3] [--format=wav|flac] [--rate=48000] "
+                          "[--channels=1] [--bits=24] [--threads=n] [--silence=-90] [--max-length=30] [--start=0]",
+                          "Renders a grid of notes and parameters to a folder of audio files",
+                          "Each note is rendered until it decays below the silence threshold, optionally "
+                          "starting part-way through the note (--start, in seconds). A manifest of "
+                          "finished files is kept in the output folder, and re-running the same command "
+                          "resumes from where it stopped.",
+                          runSampleExport });
+
+        app.addCommand ({ "--make-bank",
+                          "--make-bank --input=<presets.json|presets.xml>[,...] --output=<bank.mpbank>",
+                          "Converts lists of presets into a binary preset bank",
+                          "Each input is either a JSON file holding a \"presets\" array, or an XML file of "
+                          "<PRESET> elements. Any per-mode values a preset doesn't give are worked out from "
+                          "its string settings.",
+                          runMakeBank });
+
+        app.addCommand ({ "--analyse",
+                          "--analyse --input=<file|folder|asset>[,...] --output=<modes.json|bank.mpbank> [--note=60] "
+                          "[--modes=50] [--fft-order=13] [--seconds=20] [--threads=n]",
+                          "Extracts the modes of recorded notes into presets",
+                          "Each recording should hold one decaying note. Its partials are followed from its "
+                          "loudest point, and each one's frequency, decay and starting level become a mode. "
+                          "The fundamental is the recorded --note if given, or else the lowest strong partial. "
+                          "Inputs that aren't files are looked for in the demo assets, e.g. cello.wav. The "
+                          "output is a bank if it ends in .mpbank, and a JSON preset list otherwise.",
+                          runAnalysis });
+
+        app.addCommand ({ "--benchmark",
+                          "--benchmark=<name> [--seconds=60]",
+                          "Runs one of the render path benchmarks",
+                          "Available benchmarks:\n"
+                          "  denormals - renders a long note tail with and without subnormal protection\n"
+                          "  precision - measures the error of the float mode bank against the double one\n"
+                          "  sine      - compares the accuracy and speed of the sine kernel with LEAF's tCycle\n"
+                          "  kernels   - times each instruction set variant of the render loop that the CPU supports\n"
+                          "  resonators - times banks of 64, 128 and 256 noise-driven resonators\n"
+                          "  sympathetic - times 16, 64 and 128 sympathetic strings driven by a chord\n"
+                          "  expression - times 15 MPE notes under a dense stream of per-note controllers\n"
+                          "  bank      - times opening a bank of --presets=10000 presets and fetching 100 of them",
+                          ModalBenchmarks::run });
+
+        app.addCommand ({ "--graph",
+                          "--graph [--chains=16] [--effects=2] [--threads=n] [--seconds=10] [--block=256] [--rate=48000] "
+                          "[--realtime[=cores]] [--priority=70]",
+                          "Renders parallel chains of synths and effects through the graph host",
+                          "Each chain is an AudioProcessorGraph holding the synth plugin followed by a number of "
+                          "delays and look-ahead limiters, and all the chains are mixed into a master limiter. "
+                          "The chains are spread across the threads, with their latencies lined up, and the "
+                          "time taken by each one is reported as a proportion of the audio it rendered. With "
+                          "--realtime, memory is locked and the threads run as SCHED_FIFO on the given or "
+                          "isolated cores.",
+                          runGraph });
+
+        app.addCommand ({ "--loopback",
+                          "--loopback [--seconds=10] [--fast] [--block=256] [--rate=48000] [--inputs=2] [--outputs=2] "
+                          "[--latency=0] [--notes-per-second=4] [--hold=1] [--realtime[=cores]] [--output=<capture.wav>]",
+                          "Runs the synth's audio callback on a software device and times it",
+                          "The device calls the same callback chain as the window does, either paced in real "
+                          "time or, with --fast, as fast as it can. Notes are played on a fixed schedule, so "
+                          "--fast runs render the same output each time; its level is printed, and it can be "
+                          "saved with --output. The inputs hear the outputs a block plus --latency samples later.",
+                          runLoopback });
+
+        app.addCommand ({ "--latency-test",
+                          "--latency-test [--seconds=5] [--signal=mls|chirp] [--block=256] [--rate=48000] [--latency=0] [--fast]",
+                          "Checks the latency meter against the loopback device",
+                          "Measures the round trip through the loopback device with the test signal, and fails "
+                          "unless every period comes to exactly one block plus --latency samples. Then it times "
+                          "notes played on the keyboard to the synth's first audible sample.",
+                          runLatencyTest });
+
+        return app.findAndRunCommand (ArgumentList ("AudioSynthesiserDemo", commandLineArgs), true);
+    }
+}
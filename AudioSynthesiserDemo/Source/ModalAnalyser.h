@@ -0,0 +1,498 @@
+/*
+  ==============================================================================
+
+    Extracts the modes of a plucked or struck recording, so the modal voice
+    can be fitted to a real instrument.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "DemoUtilities.h"
+#include "ModalPresetBank.h"
+
+//==============================================================================
+/** Finds the partials in a recording of a single decaying note, and turns
+    them into a preset whose modes can be played by the modal voice.
+
+    The recording is cut into overlapping windowed frames starting from its
+    loudest point, and each frame's spectrum is worked out. The strongest
+    peaks of the first frame become the partials, and each one is followed
+    from frame to frame while it stays above the noise. A straight line
+    fitted to a partial's level in dB against time gives its decay rate, and
+    where that line starts gives its initial amplitude.
+
+    The frames, and then the partials, are spread across a thread pool. The
+    thread that calls analyse() takes its share of the work too, so several
+    files can be analysed at once by jobs on the same pool without any of
+    them waiting for a free thread.
+*/
+class ModalAnalyser
+{
+public:
+    struct Options
+    {
+        int fftOrder = 13;                  // 8192-sample frames
+        int overlap = 4;                    // how many frames start within one frame's length
+        int maxModes = ModalPreset::numModes;
+        float peakRangeDb = 60.0f;          // how far below the loudest peak a partial can start
+        float noiseMarginDb = 6.0f;         // how far above the noise floor a partial must stay to be followed
+        double maxSeconds = 20.0;           // how much of each recording to look at
+        int midiNote = -1;                  // the note that was recorded, or -1 to guess it from the partials
+    };
+
+    /** One partial that was followed through the recording. */
+    struct Partial
+    {
+        float frequency = 0.0f;             // in Hz
+        float decayRate = 0.0f;             // in nepers per second
+        float amplitude = 0.0f;             // at the start of the note, relative to full scale
+        int numFrames = 0;                  // how many frames it was followed for
+    };
+
+    struct Analysis
+    {
+        double sampleRate = 0.0, fundamental = 0.0;
+        int numFrames = 0;
+        std::vector<Partial> partials;      // in order of frequency, lowest first
+        ModalPresetBank::Entry entry;
+    };
+
+    ModalAnalyser (const Options& optionsToUse, ThreadPool* poolToUse)
+        : options (optionsToUse),
+          pool (poolToUse),
+          fft (jlimit (8, 16, options.fftOrder))
+    {
+    }
+
+    /** Opens a recording, either from a file or from one of the demo assets,
+        e.g. "cello.wav".
+    */
+    static std::unique_ptr<AudioFormatReader> createReader (AudioFormatManager& formatManager, const String& pathOrAsset)
+    {
+        auto file = File::getCurrentWorkingDirectory().getChildFile (pathOrAsset);
+
+        if (file.existsAsFile())
+            return std::unique_ptr<AudioFormatReader> (formatManager.createReaderFor (file));
+
+        if (auto stream = createAssetInputStream (pathOrAsset.toRawUTF8()))
+            return std::unique_ptr<AudioFormatReader> (formatManager.createReaderFor (std::move (stream)));
+
+        return {};
+    }
+
+    /** Analyses a recording, mixed down to mono, and fills in a preset named after it. */
+    Result analyse (AudioFormatReader& reader, const String& name, Analysis& analysis)
+    {
+        auto fftSize = fft.getSize();
+        auto hopSize = jmax (1, fftSize / jmax (1, options.overlap));
+        auto numSamples = (int) jmin (reader.lengthInSamples, (int64) (options.maxSeconds * reader.sampleRate));
+
+        if (numSamples < fftSize || reader.numChannels == 0)
+            return Result::fail (name + " is too short to analyse");
+
+        AudioBuffer<float> buffer ((int) reader.numChannels, numSamples);
+
+        if (! reader.read (&buffer, 0, numSamples, 0, true, true))
+            return Result::fail ("Couldn't read " + name);
+
+        for (int channel = 1; channel < buffer.getNumChannels(); ++channel)
+            buffer.addFrom (0, 0, buffer, channel, 0, numSamples);
+
+        buffer.applyGain (0, 0, numSamples, 1.0f / (float) buffer.getNumChannels());
+
+        // the note's decay starts from its loudest point, so the frames start there too
+        auto* samples = buffer.getReadPointer (0);
+        auto onset = (int) (std::max_element (samples, samples + numSamples,
+                                              [] (float a, float b) { return std::abs (a) < std::abs (b); }) - samples);
+
+        analysis.sampleRate = reader.sampleRate;
+        analysis.numFrames = (numSamples - onset - fftSize) / hopSize + 1;
+
+        if (analysis.numFrames < minFramesPerPartial)
+            return Result::fail (name + " doesn't have enough of the note after its peak to analyse");
+
+        auto spectra = getSpectra (samples + onset, analysis.numFrames, hopSize, reader.sampleRate);
+        auto secondsPerFrame = hopSize / reader.sampleRate;
+
+        // the candidate partials are the strongest peaks at the start of the note
+        auto peaks = findPeaks (spectra.getFrame (0));
+        std::vector<Partial> partials (peaks.size());
+
+        parallelFor ((int) peaks.size(), [&] (int i)
+        {
+            partials[(size_t) i] = trackPartial (spectra, peaks[(size_t) i], secondsPerFrame);
+        });
+
+        partials.erase (std::remove_if (partials.begin(), partials.end(), [] (const Partial& p) { return p.numFrames == 0; }),
+                        partials.end());
+
+        if (partials.empty())
+            return Result::fail ("Couldn't find any partials in " + name);
+
+        analysis.fundamental = options.midiNote >= 0 ? MidiMessage::getMidiNoteInHertz (options.midiNote)
+                                                     : guessFundamental (partials);
+
+        // anything well below the fundamental is body or room noise rather than a mode of the string
+        partials.erase (std::remove_if (partials.begin(), partials.end(),
+                                        [&] (const Partial& p) { return p.frequency < analysis.fundamental * 0.9; }),
+                        partials.end());
+
+        // two candidates can end up following the same partial, in which case the quieter one is dropped
+        std::sort (partials.begin(), partials.end(), [] (const Partial& a, const Partial& b) { return a.amplitude > b.amplitude; });
+        std::vector<Partial> distinct;
+
+        for (auto& partial : partials)
+            if (std::none_of (distinct.begin(), distinct.end(),
+                              [&] (const Partial& p) { return std::abs (p.frequency - partial.frequency) < 2.0 * spectra.binWidth; }))
+                distinct.push_back (partial);
+
+        if (distinct.empty())
+            return Result::fail ("Couldn't find any partials above the fundamental in " + name);
+
+        partials = distinct;
+        partials.resize (jmin (partials.size(), (size_t) jlimit (1, ModalPreset::numModes, options.maxModes)));
+        std::sort (partials.begin(), partials.end(), [] (const Partial& a, const Partial& b) { return a.frequency < b.frequency; });
+
+        analysis.partials = partials;
+        analysis.entry = makeEntry (partials, analysis.fundamental, name);
+        return Result::ok();
+    }
+
+    //==============================================================================
+    /** Calls a function for every index from 0 to numItems - 1, spread across
+        the pool and the calling thread, and returns when they've all finished.
+    */
+    template <typename Function>
+    void parallelFor (int numItems, Function&& function)
+    {
+        if (pool == nullptr || numItems < 2)
+        {
+            for (int i = 0; i < numItems; ++i)
+                function (i);
+
+            return;
+        }
+
+        // jobs that only start after the caller has done all the work find
+        // nothing left to do, but still need the counters, so they share them
+        struct Work
+        {
+            std::atomic<int> next { 0 }, numDone { 0 };
+            int numItems = 0;
+            std::function<void (int)> function;
+            WaitableEvent finished;
+
+            void run()
+            {
+                for (int i; (i = next++) < numItems;)
+                {
+                    function (i);
+
+                    if (++numDone == numItems)
+                        finished.signal();
+                }
+            }
+        };
+
+        auto work = std::make_shared<Work>();
+        work->numItems = numItems;
+        work->function = function;
+
+        for (int i = 0; i < jmin (numItems - 1, pool->getNumThreads()); ++i)
+            pool->addJob ([work] { work->run(); });
+
+        work->run();
+        work->finished.wait();
+    }
+
+    //==============================================================================
+    /** An in-place radix-2 complex FFT, with its twiddles and bit-reversal
+        order worked out up front. It's only read once it's been built, so one
+        can be shared by any number of threads.
+    */
+    class FFT
+    {
+    public:
+        explicit FFT (int order)
+            : size (1 << order),
+              cosTable ((size_t) size / 2), sinTable ((size_t) size / 2),
+              bitReversed ((size_t) size)
+        {
+            for (int i = 0; i < size / 2; ++i)
+            {
+                auto angle = -MathConstants<double>::twoPi * i / size;
+                cosTable[(size_t) i] = (float) std::cos (angle);
+                sinTable[(size_t) i] = (float) std::sin (angle);
+            }
+
+            for (int i = 0; i < size; ++i)
+            {
+                int reversed = 0;
+
+                for (int bit = 0; bit < order; ++bit)
+                    reversed |= ((i >> bit) & 1) << (order - 1 - bit);
+
+                bitReversed[(size_t) i] = reversed;
+            }
+        }
+
+        int getSize() const noexcept        { return size; }
+
+        void perform (float* real, float* imag) const noexcept
+        {
+            for (int i = 0; i < size; ++i)
+            {
+                auto j = bitReversed[(size_t) i];
+
+                if (i < j)
+                {
+                    std::swap (real[i], real[j]);
+                    std::swap (imag[i], imag[j]);
+                }
+            }
+
+            for (int length = 2; length <= size; length <<= 1)
+            {
+                auto half = length / 2;
+                auto step = size / length;
+
+                for (int start = 0; start < size; start += length)
+                {
+                    for (int k = 0; k < half; ++k)
+                    {
+                        auto wr = cosTable[(size_t) (k * step)], wi = sinTable[(size_t) (k * step)];
+                        auto a = start + k, b = a + half;
+                        auto tr = real[b] * wr - imag[b] * wi;
+                        auto ti = real[b] * wi + imag[b] * wr;
+
+                        real[b] = real[a] - tr;
+                        imag[b] = imag[a] - ti;
+                        real[a] += tr;
+                        imag[a] += ti;
+                    }
+                }
+            }
+        }
+
+    private:
+        int size;
+        std::vector<float> cosTable, sinTable;
+        std::vector<int> bitReversed;
+    };
+
+private:
+    //==============================================================================
+    /** The level in dB of every bin of every frame, along with each frame's noise floor. */
+    struct Spectra
+    {
+        int numFrames = 0, numBins = 0;
+        double binWidth = 0.0;              // in Hz
+        std::vector<float> levels, noiseFloors;
+
+        const float* getFrame (int frame) const noexcept    { return levels.data() + (size_t) frame * (size_t) numBins; }
+        float* getFrame (int frame) noexcept                { return levels.data() + (size_t) frame * (size_t) numBins; }
+    };
+
+    Spectra getSpectra (const float* samples, int numFrames, int hopSize, double sampleRate)
+    {
+        auto fftSize = fft.getSize();
+
+        Spectra spectra;
+        spectra.numFrames = numFrames;
+        spectra.numBins = fftSize / 2 + 1;
+        spectra.binWidth = sampleRate / fftSize;
+        spectra.levels.resize ((size_t) numFrames * (size_t) spectra.numBins);
+        spectra.noiseFloors.resize ((size_t) numFrames);
+
+        std::vector<float> window ((size_t) fftSize);
+
+        for (int i = 0; i < fftSize; ++i)
+            window[(size_t) i] = 0.5f - 0.5f * std::cos (MathConstants<float>::twoPi * (float) i / (float) fftSize);
+
+        // a sine of amplitude A peaks at A times half the window's sum
+        auto windowSum = std::accumulate (window.begin(), window.end(), 0.0f);
+        auto scale = 2.0f / windowSum;
+
+        // frames are handed out in chunks so that each chunk only needs one set of buffers
+        const int framesPerChunk = 8;
+        auto numChunks = (numFrames + framesPerChunk - 1) / framesPerChunk;
+
+        parallelFor (numChunks, [&] (int chunk)
+        {
+            std::vector<float> real ((size_t) fftSize), imag ((size_t) fftSize), sorted ((size_t) spectra.numBins);
+
+            for (int frame = chunk * framesPerChunk; frame < jmin (numFrames, (chunk + 1) * framesPerChunk); ++frame)
+            {
+                auto* frameSamples = samples + (size_t) frame * (size_t) hopSize;
+
+                for (int i = 0; i < fftSize; ++i)
+                    real[(size_t) i] = frameSamples[i] * window[(size_t) i];
+
+                std::fill (imag.begin(), imag.end(), 0.0f);
+                fft.perform (real.data(), imag.data());
+
+                auto* levels = spectra.getFrame (frame);
+
+                for (int bin = 0; bin < spectra.numBins; ++bin)
+                    levels[bin] = Decibels::gainToDecibels (std::hypot (real[(size_t) bin], imag[(size_t) bin]) * scale, silenceDb);
+
+                // most bins of a note's spectrum hold no partial, so their median is a fair noise floor
+                std::copy (levels, levels + spectra.numBins, sorted.begin());
+                std::nth_element (sorted.begin(), sorted.begin() + spectra.numBins / 2, sorted.end());
+                spectra.noiseFloors[(size_t) frame] = sorted[(size_t) spectra.numBins / 2];
+            }
+        });
+
+        return spectra;
+    }
+
+    /** Returns the bins of the strongest local maxima that are clear of their
+        neighbours' window sidelobes, loudest first.
+    */
+    std::vector<int> findPeaks (const float* levels) const
+    {
+        auto numBins = fft.getSize() / 2 + 1;
+        auto loudest = *std::max_element (levels, levels + numBins);
+        std::vector<int> peaks;
+
+        for (int bin = 2; bin < numBins - 2; ++bin)
+        {
+            auto level = levels[bin];
+
+            if (level > loudest - options.peakRangeDb
+                 && level > levels[bin - 1] && level >= levels[bin + 1]
+                 && level > levels[bin - 2] && level >= levels[bin + 2])
+                peaks.push_back (bin);
+        }
+
+        std::sort (peaks.begin(), peaks.end(), [levels] (int a, int b) { return levels[a] > levels[b]; });
+
+        // keep some spares, as a few candidates will turn out to be noise
+        peaks.resize (jmin (peaks.size(), (size_t) options.maxModes * 2));
+        return peaks;
+    }
+
+    /** Follows one peak through the frames, and fits a decay to its level. */
+    Partial trackPartial (const Spectra& spectra, int startBin, double secondsPerFrame) const
+    {
+        std::vector<double> times, levels;
+        double binSum = 0.0;
+        auto bin = startBin;
+
+        for (int frame = 0; frame < spectra.numFrames; ++frame)
+        {
+            auto* frameLevels = spectra.getFrame (frame);
+
+            // a partial drifts a little as it decays, so it's looked for near where it was last
+            auto lowest = jmax (1, bin - 2), highest = jmin (spectra.numBins - 2, bin + 2);
+            bin = (int) (std::max_element (frameLevels + lowest, frameLevels + highest + 1) - frameLevels);
+
+            auto level = frameLevels[bin];
+
+            if (level < spectra.noiseFloors[(size_t) frame] + options.noiseMarginDb)
+                break;
+
+            // a parabola through the peak and its neighbours finds its centre between bins
+            auto below = frameLevels[bin - 1], above = frameLevels[bin + 1];
+            auto curvature = below - 2.0f * level + above;
+            auto offset = curvature < 0.0f ? 0.5f * (below - above) / curvature : 0.0f;
+
+            times.push_back (frame * secondsPerFrame);
+            levels.push_back (level - 0.25f * (below - above) * offset);
+            binSum += bin + offset;
+        }
+
+        Partial partial;
+        auto n = (int) times.size();
+
+        if (n < minFramesPerPartial)
+            return partial;
+
+        // least-squares line through level against time
+        auto meanTime = std::accumulate (times.begin(), times.end(), 0.0) / n;
+        auto meanLevel = std::accumulate (levels.begin(), levels.end(), 0.0) / n;
+        double covariance = 0.0, variance = 0.0;
+
+        for (int i = 0; i < n; ++i)
+        {
+            covariance += (times[(size_t) i] - meanTime) * (levels[(size_t) i] - meanLevel);
+            variance += square (times[(size_t) i] - meanTime);
+        }
+
+        auto slope = covariance / variance;                 // dB per second
+        auto startLevel = meanLevel - slope * meanTime;
+
+        partial.frequency = (float) (binSum / n * spectra.binWidth);
+        partial.decayRate = (float) jmax (minDecayRate, -slope * std::log (10.0) / 20.0);
+        partial.amplitude = Decibels::decibelsToGain ((float) startLevel);
+        partial.numFrames = n;
+        return partial;
+    }
+
+    /** Takes the lowest partial that's within 30 dB of the loudest one as the fundamental. */
+    static double guessFundamental (const std::vector<Partial>& partials)
+    {
+        auto loudest = std::max_element (partials.begin(), partials.end(),
+                                         [] (const Partial& a, const Partial& b) { return a.amplitude < b.amplitude; })->amplitude;
+        auto fundamental = std::numeric_limits<double>::max();
+
+        for (auto& partial : partials)
+            if (partial.amplitude > loudest * Decibels::decibelsToGain (-30.0f))
+                fundamental = jmin (fundamental, (double) partial.frequency);
+
+        return fundamental;
+    }
+
+    /** Turns the partials into a preset's modes. The amplitudes are scaled to
+        add up to 1, so the loudest the note could ever be is full scale, and
+        every pickup hears every mode fully, as the recording already includes
+        whatever the real pickup or microphone did to it.
+    */
+    static ModalPresetBank::Entry makeEntry (const std::vector<Partial>& partials, double fundamental, const String& name)
+    {
+        ModalPresetBank::Entry entry;
+        entry.preset.name = name;
+
+        auto& modes = entry.modes;
+        modes = ModalPresetModes (entry.preset);
+
+        float totalAmplitude = 0.0f;
+
+        for (auto& partial : partials)
+            totalAmplitude += partial.amplitude;
+
+        for (int i = 0; i < ModalPreset::numModes; ++i)
+        {
+            if (i < (int) partials.size())
+            {
+                auto& partial = partials[(size_t) i];
+                modes.frequencyRatios[i] = (float) (partial.frequency / fundamental);
+                modes.dampings[i] = partial.decayRate / partial.frequency;     // the table multiplies this by the mode's frequency
+                modes.amplitudes[i] = partial.amplitude / totalAmplitude;
+            }
+            else
+            {
+                // unused modes are silent, and carry on above the last partial so they stay in order
+                modes.frequencyRatios[i] = (i > 0 ? modes.frequencyRatios[i - 1] : 1.0f) + 1.0f;
+                modes.amplitudes[i] = 0.0f;
+            }
+
+            for (auto& weights : modes.pickupWeights)
+                weights[i] = 1.0f;
+        }
+
+        return entry;
+    }
+
+    static constexpr int minFramesPerPartial = 3;
+    static constexpr float silenceDb = -200.0f;
+    static constexpr double minDecayRate = 0.01;            // a partial that seems to grow is treated as barely decaying
+
+    Options options;
+    ThreadPool* pool;
+    FFT fft;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalAnalyser)
+};
@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    A bounded cache of pre-rendered note attacks, shared by the modal voices.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Stores the first few milliseconds of recently played notes, so that a
+    repeated note can be played back from memory while its oscillators are
+    fast-forwarded to the end of the attack.
+
+    All the memory is allocated in prepare(); after that, every other method
+    is only ever called from the audio thread, so no locking is needed. The
+    slots share one block of memory, which is kept when prepare() is called
+    again, even for a different sample rate.
+
+    Finished recordings are found through a small open-addressed hash table
+    of their keys, and the slots are kept in a list from the most recently
+    used to the least, so neither a hit nor a miss at note-on has to look
+    through every slot.
+*/
+class ModalAttackCache
+{
+public:
+    ModalAttackCache() = default;
+
+    /** Everything that affects the output of a voice during its attack. */
+    struct Key
+    {
+        int midiNote = -1;
+        float velocity = 0, stiffness = 0, pluckPos = 0, pickupPos = 0, decay = 0, decayHighFreq = 0;
+        uint64 modesHash = 0;       // an analysed preset's modes can differ from what its settings give
+
+        bool operator== (const Key& other) const noexcept
+        {
+            return midiNote == other.midiNote && velocity == other.velocity
+                && stiffness == other.stiffness && pluckPos == other.pluckPos
+                && pickupPos == other.pickupPos && decay == other.decay
+                && decayHighFreq == other.decayHighFreq && modesHash == other.modesHash;
+        }
+    };
+
+    /** Shares the memory out between slots of the right length for a sample
+        rate. If that length hasn't changed, everything that's been recorded is
+        kept; otherwise the slots are emptied, so this mustn't be called while
+        a voice is still holding one.
+    */
+    void prepare (double sampleRate, double attackLengthMs = 50.0, size_t maxMemoryBytes = 8 * 1024 * 1024)
+    {
+        auto newAttackLength = jmax (1, roundToInt (sampleRate * attackLengthMs / 1000.0));
+        auto numFloats = jmax ((size_t) newAttackLength, maxMemoryBytes / sizeof (float));
+
+        if (numFloats != storage.size())
+        {
+            storage.assign (numFloats, 0.0f);
+            attackLength = 0;
+        }
+
+        if (newAttackLength == attackLength)
+            return;
+
+        attackLength = newAttackLength;
+        slots.assign (storage.size() / (size_t) attackLength, {});
+
+        // the table is kept at most half full, so a probe soon reaches an empty entry
+        index.assign ((size_t) nextPowerOfTwo (jmax (2, (int) slots.size() * 2)), -1);
+        indexMask = index.size() - 1;
+
+        auto numSlots = (int) slots.size();
+
+        for (int i = 0; i < numSlots; ++i)
+        {
+            slots[(size_t) i].newer = i > 0 ? i - 1 : -1;
+            slots[(size_t) i].older = i < numSlots - 1 ? i + 1 : -1;
+        }
+
+        newest = numSlots > 0 ? 0 : -1;
+        oldest = numSlots - 1;
+    }
+
+    /** Returns how much memory the cache is holding on to. */
+    size_t getReservedBytes() const noexcept
+    {
+        return storage.capacity() * sizeof (float) + slots.capacity() * sizeof (Slot) + index.capacity() * sizeof (int);
+    }
+
+    /** Touches all the cache's memory, so the audio thread doesn't fault on it. */
+    void prefault() const noexcept
+    {
+        ModalRealtimeProfile::prefault (storage);
+        ModalRealtimeProfile::prefault (slots);
+        ModalRealtimeProfile::prefault (index);
+    }
+
+    void setEnabled (bool shouldBeEnabled) noexcept     { enabled = shouldBeEnabled; }
+    bool isEnabled() const noexcept                     { return enabled && ! slots.empty(); }
+
+    /** The number of samples stored for each attack. */
+    int getAttackLength() const noexcept                { return attackLength; }
+
+    //==============================================================================
+    /** Looks for a finished recording of this key. If one is found, the slot
+        is held until release() is called, and its index is returned.
+    */
+    int acquire (const Key& key) noexcept
+    {
+        if (index.empty())
+            return -1;
+
+        for (auto i = (size_t) hashKey (key) & indexMask;; i = (i + 1) & indexMask)
+        {
+            auto slotIndex = index[i];
+
+            if (slotIndex < 0)
+                return -1;
+
+            auto& slot = slots[(size_t) slotIndex];
+
+            if (slot.key == key)
+            {
+                ++slot.numUsers;
+                makeNewest (slotIndex);
+                return slotIndex;
+            }
+        }
+    }
+
+    /** Claims the least recently used free slot for recording a new attack,
+        returning -1 if every slot is currently in use.
+    */
+    int beginRecording (const Key& key) noexcept
+    {
+        // the only slots passed over are the ones the voices are holding, so this is a short walk
+        auto slotIndex = oldest;
+
+        while (slotIndex >= 0 && slots[(size_t) slotIndex].numUsers > 0)
+            slotIndex = slots[(size_t) slotIndex].newer;
+
+        if (slotIndex >= 0)
+        {
+            auto& slot = slots[(size_t) slotIndex];
+
+            if (slot.state == Slot::ready)
+                removeFromIndex (slotIndex);
+
+            slot.key = key;
+            slot.state = Slot::recording;
+            slot.numUsers = 1;
+            makeNewest (slotIndex);
+        }
+
+        return slotIndex;
+    }
+
+    /** Ends a recording started with beginRecording(). If it isn't valid
+        (e.g. the note was cut short), the slot is simply freed again, and is
+        the first to be reused.
+    */
+    void finishRecording (int slotIndex, bool isValid) noexcept
+    {
+        auto& slot = slots[(size_t) slotIndex];
+        slot.state = isValid ? Slot::ready : Slot::empty;
+        --slot.numUsers;
+
+        if (isValid)
+            addToIndex (slotIndex);
+        else
+            makeOldest (slotIndex);
+    }
+
+    /** Lets go of a slot that was returned by acquire(). */
+    void release (int slotIndex) noexcept
+    {
+        --slots[(size_t) slotIndex].numUsers;
+    }
+
+    float* getSamples (int slotIndex) noexcept          { return storage.data() + (size_t) slotIndex * (size_t) attackLength; }
+    const Key& getKey (int slotIndex) const noexcept    { return slots[(size_t) slotIndex].key; }
+
+private:
+    //==============================================================================
+    struct Slot
+    {
+        enum State { empty, recording, ready };
+
+        Key key;
+        State state = empty;
+        int numUsers = 0;
+        int newer = -1, older = -1;     // the neighbours in the list from the most recently used
+    };
+
+    static uint64 hashKey (const Key& key) noexcept
+    {
+        auto hash = key.modesHash ^ (uint64) (uint32) key.midiNote;
+
+        // adding zero turns -0 into +0, since the two compare equal
+        for (auto value : { key.velocity, key.stiffness, key.pluckPos, key.pickupPos, key.decay, key.decayHighFreq })
+        {
+            uint32 bits;
+            value += 0.0f;
+            std::memcpy (&bits, &value, sizeof (bits));
+            hash = (hash ^ bits) * 0x100000001b3ull;
+        }
+
+        return hash ^ (hash >> 32);
+    }
+
+    void addToIndex (int slotIndex) noexcept
+    {
+        auto i = (size_t) hashKey (slots[(size_t) slotIndex].key) & indexMask;
+
+        while (index[i] >= 0)
+            i = (i + 1) & indexMask;
+
+        index[i] = slotIndex;
+    }
+
+    /** Takes a slot out of the table, and moves back any entries after it that
+        would otherwise no longer be reachable from where their keys hash to.
+    */
+    void removeFromIndex (int slotIndex) noexcept
+    {
+        auto hole = (size_t) hashKey (slots[(size_t) slotIndex].key) & indexMask;
+
+        while (index[hole] != slotIndex)
+        {
+            jassert (index[hole] >= 0);
+            hole = (hole + 1) & indexMask;
+        }
+
+        index[hole] = -1;
+
+        for (auto i = (hole + 1) & indexMask; index[i] >= 0; i = (i + 1) & indexMask)
+        {
+            auto home = (size_t) hashKey (slots[(size_t) index[i]].key) & indexMask;
+
+            // the entry can fill the hole if the hole lies between its home and where it is now
+            if (((i - home) & indexMask) >= ((i - hole) & indexMask))
+            {
+                index[hole] = index[i];
+                index[i] = -1;
+                hole = i;
+            }
+        }
+    }
+
+    void unlink (int slotIndex) noexcept
+    {
+        auto& slot = slots[(size_t) slotIndex];
+
+        if (slot.newer >= 0)    slots[(size_t) slot.newer].older = slot.older;
+        else                    newest = slot.older;
+
+        if (slot.older >= 0)    slots[(size_t) slot.older].newer = slot.newer;
+        else                    oldest = slot.newer;
+
+        slot.newer = slot.older = -1;
+    }
+
+    void makeNewest (int slotIndex) noexcept
+    {
+        unlink (slotIndex);
+        slots[(size_t) slotIndex].older = newest;
+
+        if (newest >= 0)
+            slots[(size_t) newest].newer = slotIndex;
+
+        newest = slotIndex;
+
+        if (oldest < 0)
+            oldest = slotIndex;
+    }
+
+    void makeOldest (int slotIndex) noexcept
+    {
+        unlink (slotIndex);
+        slots[(size_t) slotIndex].newer = oldest;
+
+        if (oldest >= 0)
+            slots[(size_t) oldest].older = slotIndex;
+
+        oldest = slotIndex;
+
+        if (newest < 0)
+            newest = slotIndex;
+    }
+
+    std::vector<Slot> slots;
+    std::vector<float> storage;     // each slot's samples, one after another
+    std::vector<int> index;         // the ready slots, by the hash of their keys, or -1
+    size_t indexMask = 0;
+    int newest = -1, oldest = -1;
+    int attackLength = 0;
+    std::atomic<bool> enabled { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalAttackCache)
+};
@@ -0,0 +1,586 @@
+/*
+  ==============================================================================
+
+    Benchmarks for the modal synth's render path, run from the command line
+    with --benchmark=<name>.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalOfflineRenderer.h"
+#include "ModalPresetBank.h"
+
+//==============================================================================
+namespace ModalBenchmarks
+{
+    /** Times a block of code and returns the number of milliseconds it took. */
+    template <typename Function>
+    double timeMs (Function&& function)
+    {
+        auto start = Time::getHighResolutionTicks();
+        function();
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1000.0;
+    }
+
+    //==============================================================================
+    /** Renders a long decaying note with and without each kind of subnormal
+        protection, to show what the protection is worth.
+    */
+    inline void runDenormals (const ArgumentList& args)
+    {
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 60.0;
+        const double sampleRate = 48000.0;
+        const ModalNoteSettings note { 36, 1.0f, 0.0f, 0.2f, 0.3f };
+
+        struct Config { const char* name; bool flushToZero, flushModes; };
+
+        for (auto config : { Config { "no protection",           false, false },
+                             Config { "flush-to-zero only",      true,  false },
+                             Config { "mode flushing only",      false, true  },
+                             Config { "flush-to-zero and modes", true,  true  } })
+        {
+            OfflineModalRenderer renderer (sampleRate);
+            renderer.setDenormalProtection (config.flushToZero, config.flushModes);
+            SubnormalCounter::reset();
+
+            auto ms = timeMs ([&]
+            {
+                renderer.renderRange (note, 0, (int) (seconds * sampleRate),
+                                      [] (const AudioBuffer<float>&, int) { return true; });
+            });
+
+            std::cout << String (config.name).paddedRight (' ', 26) << String (ms, 1).paddedLeft (' ', 9) << " ms"
+                     #if JUCE_DEBUG
+                      << "   " << SubnormalCounter::getReport()
+                     #endif
+                      << std::endl;
+        }
+    }
+
+    //==============================================================================
+    /** Renders long sustained notes with each of the voice's precisions, and
+        compares the float versions against the double reference over time.
+        The error is reported in dB relative to the peak of the reference, for
+        each section of the note, so any drift shows up as a rising figure.
+    */
+    inline void runPrecision (const ArgumentList& args)
+    {
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 60.0;
+        const double sampleRate = 48000.0;
+        const int numSections = 6;
+        auto numSamples = (int) (seconds * sampleRate);
+
+        using Precision = SineWaveVoice::Precision;
+
+        auto render = [&] (const ModalNoteSettings& note, Precision precision, std::vector<float>& output)
+        {
+            OfflineModalRenderer renderer (sampleRate);
+            renderer.setPrecision (precision);
+            output.clear();
+            output.reserve ((size_t) numSamples);
+
+            return timeMs ([&]
+            {
+                renderer.renderRange (note, 0, numSamples, [&] (const AudioBuffer<float>& block, int num)
+                {
+                    output.insert (output.end(), block.getReadPointer (0), block.getReadPointer (0) + num);
+                    return true;
+                });
+            });
+        };
+
+        auto toDb = [] (double gain)    { return String (Decibels::gainToDecibels (gain, -300.0), 1); };
+
+        for (auto midiNote : { 36, 60, 84 })
+        {
+            const ModalNoteSettings note { midiNote, 1.0f, 0.0f, 0.2f, 0.3f };
+            std::vector<float> reference, test;
+
+            auto referenceMs = render (note, Precision::float64, reference);
+            auto range = FloatVectorOperations::findMinAndMax (reference.data(), (int) reference.size());
+            auto peak = (double) jmax (range.getEnd(), -range.getStart());
+
+            std::cout << "Note " << midiNote << ", " << seconds << " s: double reference " << String (referenceMs, 1) << " ms" << std::endl;
+
+            struct Config { const char* name; Precision precision; };
+
+            for (auto config : { Config { "float",             Precision::float32 },
+                                 Config { "float compensated", Precision::float32Compensated } })
+            {
+                auto ms = render (note, config.precision, test);
+                StringArray sections;
+                double worst = 0.0;
+
+                for (int section = 0; section < numSections; ++section)
+                {
+                    auto start = (size_t) numSamples * (size_t) section / numSections;
+                    auto end   = (size_t) numSamples * (size_t) (section + 1) / numSections;
+                    double error = 0.0;
+
+                    for (auto i = start; i < end; ++i)
+                        error = jmax (error, std::abs ((double) test[i] - (double) reference[i]));
+
+                    sections.add (toDb (error / peak));
+                    worst = jmax (worst, error);
+                }
+
+                std::cout << "  " << String (config.name).paddedRight (' ', 18) << String (ms, 1).paddedLeft (' ', 9) << " ms"
+                          << "   worst error " << toDb (worst / peak) << " dB"
+                          << "   per section: " << sections.joinIntoString (" ") << std::endl;
+            }
+        }
+    }
+
+    //==============================================================================
+    /** Compares the polynomial sine kernel's accuracy tiers with LEAF's tCycle,
+        for the worst error over a long run and for the time taken to tick a
+        full bank of oscillators.
+    */
+    inline void runSine (const ArgumentList& args)
+    {
+        using namespace ModalSineKernel;
+
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 10.0;
+        const double sampleRate = 48000.0;
+        const int numOscillators = roundUpToLanes (ModeTable::numModes);
+        auto numSamples = (int) (seconds * sampleRate);
+
+        LEAF leaf;
+        std::vector<char> leafMemory (65536);
+        LEAF_init (&leaf, (float) sampleRate, leafMemory.data(), leafMemory.size(), []() { return 0.0f; });
+
+        // this frequency is an exact number of phase steps, so every oscillator should produce exactly
+        // the same phases, and over 2^20 samples they'll visit 2^20 different points in the cycle
+        const double testFrequency = sampleRate * 9973.0 / (1 << 20);
+        auto error = [&] (auto&& nextSample)
+        {
+            double worst = 0.0;
+
+            for (int i = 0; i < (1 << 20); ++i)
+                worst = jmax (worst, std::abs (nextSample() - std::sin (MathConstants<double>::twoPi * 9973.0 * i / (1 << 20))));
+
+            return String (Decibels::gainToDecibels (worst, -300.0), 1) + " dB";
+        };
+
+        tCycle cycles[numOscillators];
+        Phase phases[numOscillators] = {}, increments[numOscillators] = {};
+        float outputs[numOscillators] = {};
+
+        for (int i = 0; i < numOscillators; ++i)
+        {
+            auto frequency = 55.0 * (i + 1);
+            tCycle_init (&cycles[i], &leaf);
+            tCycle_setFreq (&cycles[i], (float) frequency);
+            increments[i] = phaseIncrement (frequency, sampleRate);
+        }
+
+        // the sum is printed so that the compiler can't throw the work away
+        float sum = 0.0f;
+        auto report = [&] (const char* name, const String& worstError, double ms)
+        {
+            std::cout << String (name).paddedRight (' ', 20) << ("worst error " + worstError).paddedRight (' ', 22)
+                      << String (ms, 1).paddedLeft (' ', 9) << " ms  "
+                      << String (ms * 1.0e6 / ((double) numSamples * numOscillators), 2) << " ns per oscillator sample" << std::endl;
+        };
+
+        {
+            tCycle reference;
+            tCycle_init (&reference, &leaf);
+            tCycle_setFreq (&reference, (float) testFrequency);
+            tCycle_setPhase (&reference, 0.0f);
+            auto worstError = error ([&] { return (double) tCycle_tick (&reference); });
+
+            auto ms = timeMs ([&]
+            {
+                for (int i = 0; i < numSamples; ++i)
+                    for (int j = 0; j < numOscillators; ++j)
+                        sum += tCycle_tick (&cycles[j]);
+            });
+
+            report ("tCycle", worstError, ms);
+        }
+
+        auto runTier = [&] (const char* name, auto tier)
+        {
+            constexpr Accuracy accuracy = decltype (tier)::value;
+
+            Phase phase = 0;
+            auto increment = phaseIncrement (testFrequency, sampleRate);
+            auto worstError = error ([&] { auto value = sine<accuracy> (phase); phase += increment; return (double) value; });
+
+            auto ms = timeMs ([&]
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    tick<accuracy> (outputs, phases, increments, numOscillators);
+
+                    for (auto output : outputs)
+                        sum += output;
+                }
+            });
+
+            report (name, worstError, ms);
+        };
+
+        runTier ("polynomial fast",     std::integral_constant<Accuracy, Accuracy::fast>());
+        runTier ("polynomial standard", std::integral_constant<Accuracy, Accuracy::standard>());
+        runTier ("polynomial precise",  std::integral_constant<Accuracy, Accuracy::precise>());
+
+        std::cout << "(checksum " << sum << ")" << std::endl;
+    }
+
+    //==============================================================================
+    /** Renders the same notes with each of the render loop's instruction set
+        variants that this CPU can run, and reports which one the synth picks.
+    */
+    inline void runKernels (const ArgumentList& args)
+    {
+        using Variant = ModalRenderKernels::Variant;
+
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 20.0;
+        const double sampleRate = 48000.0;
+        const ModalNoteSettings note { 48, 1.0f, 0.0f, 0.2f, 0.3f };
+        auto best = ModalRenderKernels::detectVariant();
+
+        std::cout << "CPU: " << SystemStats::getCpuModel() << std::endl
+                  << "Selected variant: " << ModalRenderKernels::getVariantName (best) << std::endl;
+
+        for (auto variant : { Variant::generic, Variant::avx2, Variant::avx512 })
+        {
+            if ((int) variant > (int) best)
+                break;
+
+            OfflineModalRenderer renderer (sampleRate);
+            renderer.setKernelVariant (variant);
+            renderer.setDenormalProtection (true, false);   // keep every mode running for the whole note
+
+            auto ms = timeMs ([&]
+            {
+                renderer.renderRange (note, 0, (int) (seconds * sampleRate),
+                                      [] (const AudioBuffer<float>&, int) { return true; });
+            });
+
+            std::cout << String (ModalRenderKernels::getVariantName (variant)).paddedRight (' ', 10)
+                      << String (ms, 1).paddedLeft (' ', 9) << " ms   "
+                      << String (seconds * 1000.0 / ms, 1) << "x real time" << std::endl;
+        }
+    }
+
+    //==============================================================================
+    /** Drives resonator banks of several sizes with white noise, with the
+        fastest instruction set variant, and reports how many times faster
+        than real time each one runs.
+    */
+    inline void runResonators (const ArgumentList& args)
+    {
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 10.0;
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        auto variant = ModalRenderKernels::detectVariant();
+
+        std::vector<float> input ((size_t) blockSize), output ((size_t) blockSize);
+        Random random (1);
+
+        for (auto& sample : input)
+            sample = random.nextFloat() * 2.0f - 1.0f;
+
+        std::cout << "Variant: " << ModalRenderKernels::getVariantName (variant) << std::endl;
+
+        for (auto numResonators : { 64, 128, 256 })
+        {
+            ModalResonatorBank bank (numResonators);
+            std::vector<float> weights ((size_t) bank.getCapacity());
+
+            for (int i = 0; i < numResonators; ++i)
+            {
+                bank.tune (i, 55.0 * (i + 1) * std::sqrt (1.0 + 0.0001 * i * i), 0.99995, sampleRate);
+                weights[(size_t) i] = 1.0f / (float) (i + 1);
+            }
+
+            bank.setNumResonators (numResonators);
+
+            float* outputs[] = { output.data() };
+            const float* outputWeights[] = { weights.data() };
+            auto numBlocks = (int) (seconds * sampleRate / blockSize);
+            float sum = 0.0f;
+
+            auto ms = timeMs ([&]
+            {
+                for (int block = 0; block < numBlocks; ++block)
+                {
+                    bank.process (variant, input.data(), outputs, outputWeights, 1, blockSize, 1.0f);
+                    sum += output[0];
+                }
+            });
+
+            std::cout << String (numResonators).paddedLeft (' ', 4) << " resonators"
+                      << String (ms, 1).paddedLeft (' ', 9) << " ms   "
+                      << String (numBlocks * blockSize * 1000.0 / sampleRate / ms, 1) << "x real time"
+                      << "   (checksum " << sum << ")" << std::endl;
+        }
+    }
+
+    //==============================================================================
+    /** Drives sets of 16, 64 and 128 sympathetic strings from a chord of
+        noise sources, and reports how many string-voice pairs end up coupled
+        and how many times faster than real time each set runs.
+    */
+    inline void runSympathetic (const ArgumentList& args)
+    {
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 10.0;
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int chord[] = { 48, 52, 55, 60, 64, 67, 72, 76 };
+        constexpr int numSources = (int) std::size (chord);
+
+        ModeTable table (0.0f, sampleRate);
+        auto variant = ModalRenderKernels::detectVariant();
+
+        std::vector<float> sourceData ((size_t) (blockSize * numSources)), output ((size_t) blockSize);
+        const float* sources[numSources];
+
+        for (int i = 0; i < numSources; ++i)
+        {
+            ModalNoiseSource noise ((uint32) i);
+            noise.render (sourceData.data() + i * blockSize, blockSize);
+            sources[i] = sourceData.data() + i * blockSize;
+        }
+
+        std::cout << "Variant: " << ModalRenderKernels::getVariantName (variant) << std::endl;
+
+        for (auto numStrings : { 16, 64, 128 })
+        {
+            ModalSympatheticStrings strings (numStrings, 60 - numStrings / 2, numSources, blockSize);
+
+            for (int i = 0; i < numSources; ++i)
+                strings.setSourceNote (i, chord[i]);
+
+            auto numBlocks = (int) (seconds * sampleRate / blockSize);
+            float sum = 0.0f;
+
+            auto ms = timeMs ([&]
+            {
+                for (int block = 0; block < numBlocks; ++block)
+                {
+                    FloatVectorOperations::clear (output.data(), blockSize);
+                    strings.process (table, variant, sources, output.data(), blockSize, 1.0f);
+                    sum += output[0];
+                }
+            });
+
+            std::cout << String (numStrings).paddedLeft (' ', 4) << " strings, "
+                      << String (strings.getNumCoupledPairs()).paddedLeft (' ', 4) << " coupled pairs, "
+                      << String (strings.getNumActiveStrings()).paddedLeft (' ', 4) << " active"
+                      << String (ms, 1).paddedLeft (' ', 9) << " ms   "
+                      << String (numBlocks * blockSize * 1000.0 / sampleRate / ms, 1) << "x real time"
+                      << "   (checksum " << sum << ")" << std::endl;
+        }
+    }
+
+    //==============================================================================
+    /** Holds a note on each of 15 MPE member channels, with every channel sending
+        pitch bend, pressure and timbre every millisecond, and times rendering
+        it with the controllers taken out by ModalExpression against passing
+        them all through the Synthesiser.
+    */
+    inline void runExpression (const ArgumentList& args)
+    {
+        auto seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 10.0;
+        const double sampleRate = 48000.0;
+        const int blockSize = 512, numNotes = 15, samplesPerMessage = 48;
+
+        struct Config { const char* name; bool takeControllers; };
+
+        for (auto config : { Config { "through ModalExpression", true },
+                             Config { "through the Synthesiser", false } })
+        {
+            SnapshotPublisher<ModeTable> modeTables;
+            modeTables.publish (std::make_unique<ModeTable> (ModalPreset(), sampleRate));
+
+            ModalExpression expression (numNotes);
+            expression.prepare (sampleRate, 65536);
+
+            Synthesiser synth;
+            synth.setCurrentPlaybackSampleRate (sampleRate);
+            synth.addSound (new SineWaveSound());
+
+            for (int i = 0; i < numNotes; ++i)
+            {
+                auto* voice = new SineWaveVoice();
+                voice->setModeTables (&modeTables);
+                voice->setKernelVariant (ModalRenderKernels::detectVariant());
+                voice->setMaximumBlockSize (blockSize);
+                voice->setExpression (&expression, i);
+                synth.addVoice (voice);
+            }
+
+            AudioBuffer<float> buffer (2, blockSize);
+            MidiBuffer midi;
+            midi.ensureSize (65536);
+
+            auto numBlocks = (int) (seconds * sampleRate / blockSize);
+            int64 numMessages = 0;
+            float sum = 0.0f;
+
+            auto ms = timeMs ([&]
+            {
+                for (int block = 0; block < numBlocks; ++block)
+                {
+                    midi.clear();
+
+                    // the notes are played again every second, so they never die away
+                    if (block % (int) (sampleRate / blockSize) == 0)
+                        for (int i = 0; i < numNotes; ++i)
+                            midi.addEvent (MidiMessage::noteOn (i + 2, 48 + i * 2, 0.8f), 0);
+
+                    for (int position = 0; position < blockSize; position += samplesPerMessage)
+                    {
+                        for (int i = 0; i < numNotes; ++i)
+                        {
+                            auto wobble = std::sin ((double) (block * blockSize + position) * 0.0005 + i);
+                            midi.addEvent (MidiMessage::pitchWheel (i + 2, 8192 + (int) (wobble * 200.0)), position);
+                            midi.addEvent (MidiMessage::channelPressureChange (i + 2, 64 + (int) (wobble * 60.0)), position);
+                            midi.addEvent (MidiMessage::controllerEvent (i + 2, 74, 64 + (int) (wobble * 60.0)), position);
+                            numMessages += 3;
+                        }
+                    }
+
+                    if (config.takeControllers)
+                    {
+                        expression.takeControllers (midi);
+                        expression.update (blockSize);
+                    }
+
+                    buffer.clear();
+                    synth.renderNextBlock (buffer, midi, 0, blockSize);
+                    sum += buffer.getSample (0, 0);
+                }
+            });
+
+            std::cout << String (config.name).paddedRight (' ', 26) << String (ms, 1).paddedLeft (' ', 9) << " ms   "
+                      << String (numBlocks * blockSize * 1000.0 / sampleRate / ms, 1) << "x real time   "
+                      << String ((double) numMessages / seconds, 0) << " messages/s"
+                      << "   (checksum " << sum << ")" << std::endl;
+        }
+    }
+
+    //==============================================================================
+    /** Returns how much of the process's memory is resident, or -1 where that
+        can't be found out.
+    */
+    inline int64 getResidentBytes()
+    {
+       #if JUCE_LINUX
+        for (auto& line : StringArray::fromLines (File ("/proc/self/status").loadFileAsString()))
+            if (line.startsWith ("VmRSS:"))
+                return line.substring (6).trim().getLargeIntValue() * 1024;     // in kB
+       #endif
+
+        return -1;
+    }
+
+    /** Writes a bank of many presets, then times opening it, fetching a
+        scattered handful of presets from it and building a table from one of
+        them, and reports how much memory that left resident.
+    */
+    inline void runBank (const ArgumentList& args)
+    {
+        auto numPresets = args.containsOption ("--presets") ? jmax (1, args.getValueForOption ("--presets").getIntValue()) : 10000;
+        const int numToFetch = jmin (100, numPresets);
+        const auto& factoryPresets = ModalPreset::getFactoryPresets();
+
+        std::vector<ModalPresetBank::Entry> entries;
+        entries.reserve ((size_t) numPresets);
+        Random random (1);
+
+        for (int i = 0; i < numPresets; ++i)
+        {
+            auto preset = factoryPresets[(size_t) i % factoryPresets.size()];
+            preset.name = "Preset " + String (i + 1).paddedLeft ('0', 5);
+            preset.stiffness *= 0.5f + random.nextFloat();
+            preset.pluckPos = jlimit (0.01f, 3.1f, preset.pluckPos * (0.5f + random.nextFloat()));
+            preset.decay *= 0.5f + random.nextFloat();
+            entries.push_back ({ preset, ModalPresetModes (preset) });
+        }
+
+        auto file = File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("benchmark", ".mpbank");
+
+        if (auto result = ModalPresetBank::write (file, entries); result.failed())
+            ConsoleApplication::fail (result.getErrorMessage());
+
+        entries.clear();
+        entries.shrink_to_fit();
+
+        ModalPresetBank bank;
+        auto residentBefore = getResidentBytes();
+        Result result = Result::ok();
+        auto openMs = timeMs ([&] { result = bank.open (file); });
+
+        if (result.failed())
+        {
+            file.deleteFile();
+            ConsoleApplication::fail (result.getErrorMessage());
+        }
+
+        auto residentAfterOpen = getResidentBytes();
+        int numFetched = 0;
+        float sum = 0.0f;
+
+        auto fetchMs = timeMs ([&]
+        {
+            for (int i = 0; i < numToFetch; ++i)
+            {
+                if (auto entry = bank.getPreset (random.nextInt (numPresets)))
+                {
+                    sum += entry->modes.frequencyRatios[ModalPreset::numModes - 1];
+                    ++numFetched;
+                }
+            }
+        });
+
+        auto residentAfterFetch = getResidentBytes();
+        std::unique_ptr<ModeTable> table;
+
+        auto tableMs = timeMs ([&]
+        {
+            if (auto entry = bank.getPreset (0))
+                table = std::make_unique<ModeTable> (entry->preset, entry->modes, 48000.0);
+        });
+
+        auto megabytes = [] (int64 bytes) { return String ((double) bytes / (1024.0 * 1024.0), 2) + " MB"; };
+
+        std::cout << "Presets:          " << numPresets << std::endl
+                  << "File size:        " << megabytes ((int64) bank.getFileSize()) << std::endl
+                  << "Index size:       " << megabytes ((int64) (numPresets * sizeof (ModalPresetBank::IndexEntry))) << std::endl
+                  << "Open:             " << String (openMs, 3) << " ms" << std::endl
+                  << "Fetch " << String (numFetched).paddedRight (' ', 4) << "presets: "
+                  << String (fetchMs, 3) << " ms   (checksum " << sum << ")" << std::endl
+                  << "Build one table:  " << String (tableMs, 3) << " ms" << std::endl;
+
+        if (residentBefore >= 0)
+            std::cout << "Resident after open:  +" << megabytes (residentAfterOpen - residentBefore) << std::endl
+                      << "Resident after fetch: +" << megabytes (residentAfterFetch - residentBefore) << std::endl;
+
+        bank.close();
+        file.deleteFile();
+    }
+
+    //==============================================================================
+    inline void run (const ArgumentList& args)
+    {
+        auto name = args.getValueForOption ("--benchmark");
+
+        if (name == "denormals")    return runDenormals (args);
+        if (name == "precision")    return runPrecision (args);
+        if (name == "sine")         return runSine (args);
+        if (name == "kernels")      return runKernels (args);
+        if (name == "resonators")   return runResonators (args);
+        if (name == "sympathetic")  return runSympathetic (args);
+        if (name == "expression")   return runExpression (args);
+        if (name == "bank")         return runBank (args);
+
+        ConsoleApplication::fail ("Unknown benchmark: " + name + " (expected denormals, precision, sine, kernels, resonators, sympathetic, expression or bank)");
+    }
+}
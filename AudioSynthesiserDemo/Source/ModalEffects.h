@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+    A couple of small stereo effects for putting after the synth in a
+    processor graph.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** The parts of an AudioProcessor that the effects below have in common:
+    the same number of channels in and out, no MIDI, no programs and no editor.
+*/
+class ModalEffectProcessor : public AudioProcessor
+{
+public:
+    ModalEffectProcessor()
+        : AudioProcessor (BusesProperties().withInput  ("Input",  AudioChannelSet::stereo(), true)
+                                           .withOutput ("Output", AudioChannelSet::stereo(), true))
+    {
+    }
+
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override
+    {
+        return ! layouts.getMainOutputChannelSet().isDisabled()
+                && layouts.getMainInputChannelSet() == layouts.getMainOutputChannelSet();
+    }
+
+    using AudioProcessor::processBlock;
+
+    void releaseResources() override                            {}
+    double getTailLengthSeconds() const override                { return 0.0; }
+    bool acceptsMidi() const override                           { return false; }
+    bool producesMidi() const override                          { return false; }
+
+    AudioProcessorEditor* createEditor() override               { return nullptr; }
+    bool hasEditor() const override                             { return false; }
+
+    int getNumPrograms() override                               { return 1; }
+    int getCurrentProgram() override                            { return 0; }
+    void setCurrentProgram (int) override                       {}
+    const String getProgramName (int) override                  { return {}; }
+    void changeProgramName (int, const String&) override        {}
+
+    void getStateInformation (MemoryBlock&) override            {}
+    void setStateInformation (const void*, int) override        {}
+};
+
+//==============================================================================
+/** A feedback delay whose repeats get duller each time round, like a tape echo. */
+class ModalDelayEffect final : public ModalEffectProcessor
+{
+public:
+    ModalDelayEffect (double delaySecondsToUse = 0.25, float feedbackToUse = 0.4f, float mixToUse = 0.3f)
+        : delaySeconds (delaySecondsToUse), feedback (feedbackToUse), mix (mixToUse)
+    {
+    }
+
+    const String getName() const override       { return "Delay"; }
+
+    double getTailLengthSeconds() const override
+    {
+        // how long the repeats take to fall by 60 dB
+        return feedback > 0.0f ? delaySeconds * std::log (1000.0) / -std::log ((double) feedback) : delaySeconds;
+    }
+
+    void prepareToPlay (double sampleRate, int) override
+    {
+        delayLine.setSize (getTotalNumOutputChannels(), jmax (1, roundToInt (delaySeconds * sampleRate)));
+        delayLine.clear();
+        std::fill (std::begin (dampingStates), std::end (dampingStates), 0.0f);
+        writePosition = 0;
+    }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override
+    {
+        auto length = delayLine.getNumSamples();
+        auto numChannels = jmin (buffer.getNumChannels(), delayLine.getNumChannels(), (int) maxChannels);
+        auto position = writePosition;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* samples = buffer.getWritePointer (channel);
+            auto* line = delayLine.getWritePointer (channel);
+            auto state = dampingStates[channel];
+            position = writePosition;
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                state += damping * (line[position] - state);
+                line[position] = samples[i] + feedback * state;
+                samples[i] += mix * state;
+
+                if (++position == length)
+                    position = 0;
+            }
+
+            dampingStates[channel] = state;
+        }
+
+        writePosition = position;
+    }
+
+private:
+    static constexpr int maxChannels = 64;
+    static constexpr float damping = 0.3f;      // the one-pole lowpass in the feedback path
+
+    const double delaySeconds;
+    const float feedback, mix;
+
+    AudioBuffer<float> delayLine;
+    float dampingStates[maxChannels] = {};
+    int writePosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalDelayEffect)
+};
+
+//==============================================================================
+/** A peak limiter that looks ahead, so that it can start turning the gain
+    down before a peak arrives rather than clipping it. The signal is delayed
+    by the look-ahead time, and that's reported as the processor's latency,
+    so that a graph can line it up with anything running in parallel.
+*/
+class ModalLimiterEffect final : public ModalEffectProcessor
+{
+public:
+    ModalLimiterEffect (double lookaheadSecondsToUse = 0.005, float ceilingDb = -1.0f, double releaseSecondsToUse = 0.1)
+        : lookaheadSeconds (lookaheadSecondsToUse),
+          releaseSeconds (releaseSecondsToUse),
+          ceiling (Decibels::decibelsToGain (ceilingDb))
+    {
+    }
+
+    const String getName() const override       { return "Limiter"; }
+
+    void prepareToPlay (double sampleRate, int) override
+    {
+        lookahead = jmax (1, roundToInt (lookaheadSeconds * sampleRate));
+        setLatencySamples (lookahead);
+
+        // the gain gets to within 1% of where it's heading over the look-ahead
+        attack = 1.0f - std::exp (-4.6f / (float) lookahead);
+        release = 1.0f - (float) std::exp (-1.0 / (releaseSeconds * sampleRate));
+
+        delayLine.setSize (getTotalNumOutputChannels(), lookahead);
+        delayLine.clear();
+        position = 0;
+        gain = 1.0f;
+    }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override
+    {
+        auto numChannels = jmin (buffer.getNumChannels(), delayLine.getNumChannels());
+
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        {
+            float peak = 0.0f;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                peak = jmax (peak, std::abs (buffer.getSample (channel, i)));
+
+            auto target = peak > ceiling ? ceiling / peak : 1.0f;
+            gain += (target - gain) * (target < gain ? attack : release);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* line = delayLine.getWritePointer (channel);
+                auto input = buffer.getSample (channel, i);
+                buffer.setSample (channel, i, line[position] * gain);
+                line[position] = input;
+            }
+
+            if (++position == lookahead)
+                position = 0;
+        }
+    }
+
+private:
+    const double lookaheadSeconds, releaseSeconds;
+    const float ceiling;
+
+    AudioBuffer<float> delayLine;
+    int lookahead = 1, position = 0;
+    float gain = 1.0f, attack = 1.0f, release = 1.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalLimiterEffect)
+};
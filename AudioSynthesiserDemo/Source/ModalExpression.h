@@ -0,0 +1,307 @@
+/*
+  ==============================================================================
+
+    Per-note pitch bend, pressure and timbre for the modal voices, taken from
+    MPE or ordinary channel messages.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Keeps track of the expression controls of every voice.
+
+    MPE controllers send a stream of pitch bend, channel pressure and CC74
+    messages for every note, each on the note's own channel. Passing these to
+    the Synthesiser would make it split its render at every one of them, so
+    instead they're taken out of each block's MIDI before the synth sees it,
+    and only the latest value of each control on each channel is kept. However
+    many messages arrive, the cost per block stays the same.
+
+    Once per block, each voice's controls are moved towards its channel's
+    values by a short smoother. The values are stored as one array per control
+    with an entry per voice, so this is a few vector operations over all the
+    voices at once. A voice then reads where its controls were at the start and
+    end of the block, and interpolates between them as it renders.
+
+    With MPE enabled, channel 1 is the zone's master channel, whose pitch bend
+    applies to every note, and the other channels are member channels with a
+    wider bend range. With it disabled, every channel just bends its own notes.
+
+    Everything is allocated up front, so all the methods apart from the
+    constructor and prepare() are safe to call on the audio thread.
+*/
+class ModalExpression
+{
+public:
+    enum Control
+    {
+        pitchBend,      // in semitones
+        pressure,       // 0 to 1
+        timbre,         // 0 to 1, with 0.5 in the middle
+        numControls
+    };
+
+    /** The values of a voice's controls at the start and end of the current block. */
+    struct VoiceControls
+    {
+        float start[numControls] = { 0.0f, 0.0f, 0.5f };
+        float end[numControls]   = { 0.0f, 0.0f, 0.5f };
+
+        bool isMoving() const noexcept
+        {
+            return ! std::equal (std::begin (start), std::end (start), end);
+        }
+
+        /** True if the note sounds exactly as it would with no expression at all. */
+        bool isNeutral() const noexcept
+        {
+            for (int control = 0; control < numControls; ++control)
+                if (start[control] != neutralValues[control] || end[control] != neutralValues[control])
+                    return false;
+
+            return true;
+        }
+
+        /** Returns a control's value at a point between the start (0) and the end (1) of the block. */
+        float get (Control control, float proportion) const noexcept
+        {
+            return start[control] + (end[control] - start[control]) * proportion;
+        }
+    };
+
+    explicit ModalExpression (int maxVoicesToUse)
+        : maxVoices (jmax (1, maxVoicesToUse)),
+          voiceChannels ((size_t) maxVoices, -1)
+    {
+        for (int control = 0; control < numControls; ++control)
+        {
+            targets[control].assign ((size_t) maxVoices, neutralValues[control]);
+            starts[control].assign ((size_t) maxVoices, neutralValues[control]);
+            ends[control].assign ((size_t) maxVoices, neutralValues[control]);
+        }
+
+        differences.assign ((size_t) maxVoices, 0.0f);
+        resetAllChannels();
+    }
+
+    int getMaxVoices() const noexcept                       { return maxVoices; }
+
+    /** Sets up the smoothing for a sample rate, and makes room for the MIDI that
+        a block might hold. The controllers' values are kept, so notes that
+        carry on through a change of sample rate keep their expression.
+    */
+    void prepare (double newSampleRate, int maxMidiBytesPerBlock = 8192)
+    {
+        sampleRate = newSampleRate;
+        remainingMidi.ensureSize ((size_t) maxMidiBytesPerBlock);
+        reservedMidiBytes = jmax (reservedMidiBytes, (size_t) maxMidiBytesPerBlock);
+    }
+
+    /** Returns how much memory the per-voice arrays and the MIDI scratch buffer are holding on to. */
+    size_t getReservedBytes() const noexcept
+    {
+        auto total = sizeof (*this) + voiceChannels.capacity() * sizeof (int)
+                       + differences.capacity() * sizeof (float) + reservedMidiBytes;
+
+        for (int control = 0; control < numControls; ++control)
+            total += (targets[control].capacity() + starts[control].capacity() + ends[control].capacity()) * sizeof (float);
+
+        return total;
+    }
+
+    /** Touches the per-voice arrays, so the audio thread doesn't fault on them. */
+    void prefault() const noexcept
+    {
+        ModalRealtimeProfile::prefault (this, sizeof (*this));
+        ModalRealtimeProfile::prefault (voiceChannels);
+        ModalRealtimeProfile::prefault (differences);
+
+        for (int control = 0; control < numControls; ++control)
+            for (auto* values : { &targets[control], &starts[control], &ends[control] })
+                ModalRealtimeProfile::prefault (*values);
+    }
+
+    void setMPEEnabled (bool shouldBeEnabled) noexcept      { mpeEnabled = shouldBeEnabled; }
+    bool isMPEEnabled() const noexcept                      { return mpeEnabled; }
+
+    /** Sets how far a full pitch bend moves the notes, on the master channel and
+        on the member channels. MPE's defaults are 2 and 48 semitones.
+    */
+    void setPitchBendRanges (float masterSemitones, float memberSemitones) noexcept
+    {
+        masterBendRange = masterSemitones;
+        memberBendRange = memberSemitones;
+    }
+
+    /** Returns how many expression messages have been taken out of the MIDI, for
+        keeping an eye on how busy the controllers are.
+    */
+    int64 getNumMessagesTaken() const noexcept              { return numMessagesTaken; }
+
+    //==============================================================================
+    /** Takes the pitch bend, pressure and timbre messages out of a block of MIDI,
+        remembering the last value of each on each channel, and leaves everything
+        else in the buffer in its original order. The buffer must fit in the space
+        given to prepare() for this not to allocate.
+    */
+    void takeControllers (MidiBuffer& midi) noexcept
+    {
+        remainingMidi.clear();
+
+        for (const auto metadata : midi)
+        {
+            auto* data = metadata.data;
+            auto channel = data[0] & 0x0f;
+            auto* values = channelValues[channel];
+
+            switch (data[0] & 0xf0)
+            {
+                case 0xe0:  values[pitchBend] = (float) ((data[1] | (data[2] << 7)) - 8192) / 8192.0f; break;
+                case 0xd0:  values[pressure] = (float) data[1] / 127.0f; break;
+
+                // in MPE there's only one note on a channel, so its aftertouch is the channel's pressure
+                case 0xa0:  values[pressure] = (float) data[2] / 127.0f; break;
+
+                case 0xb0:
+                    if (data[1] == 74)
+                    {
+                        values[timbre] = getCentredValue (data[2]);
+                        break;
+                    }
+
+                    if (data[1] == 121)         // reset all controllers, which the synth may want to see too
+                        resetChannel (channel);
+
+                    remainingMidi.addEvent (data, metadata.numBytes, metadata.samplePosition);
+                    continue;
+
+                default:
+                    remainingMidi.addEvent (data, metadata.numBytes, metadata.samplePosition);
+                    continue;
+            }
+
+            ++numMessagesTaken;
+        }
+
+        // copying back only ever shrinks the caller's buffer, so it doesn't allocate
+        midi.clear();
+        midi.addEvents (remainingMidi, 0, -1, 0);
+    }
+
+    /** Tells the expression which channel a voice has started a note on. The note
+        starts with the channel's current values, rather than sliding to them.
+    */
+    void startVoice (int voice, int midiChannel) noexcept
+    {
+        jassert (isPositiveAndBelow (voice, maxVoices));
+        voiceChannels[(size_t) voice] = jlimit (1, 16, midiChannel) - 1;
+
+        for (int control = 0; control < numControls; ++control)
+        {
+            auto value = getChannelValue ((Control) control, voiceChannels[(size_t) voice]);
+            targets[control][(size_t) voice] = starts[control][(size_t) voice] = ends[control][(size_t) voice] = value;
+        }
+    }
+
+    /** Moves every voice's controls towards its channel's latest values. This
+        should be called once before each block is rendered.
+    */
+    void update (int numSamples) noexcept
+    {
+        for (int voice = 0; voice < maxVoices; ++voice)
+            if (auto channel = voiceChannels[(size_t) voice]; channel >= 0)
+                for (int control = 0; control < numControls; ++control)
+                    targets[control][(size_t) voice] = getChannelValue ((Control) control, channel);
+
+        auto coefficient = (float) (1.0 - std::exp (-numSamples / (smoothingSeconds * sampleRate)));
+
+        for (int control = 0; control < numControls; ++control)
+        {
+            auto* target = targets[control].data();
+            auto* start = starts[control].data();
+            auto* end = ends[control].data();
+
+            FloatVectorOperations::copy (start, end, maxVoices);
+            FloatVectorOperations::subtract (differences.data(), target, end, maxVoices);
+            FloatVectorOperations::addWithMultiply (end, differences.data(), coefficient, maxVoices);
+
+            // once a control is close enough, it's snapped to its target so the voice can stop interpolating
+            for (int voice = 0; voice < maxVoices; ++voice)
+                if (std::abs (target[voice] - end[voice]) < snapThresholds[control])
+                    end[voice] = target[voice];
+        }
+    }
+
+    VoiceControls getControls (int voice) const noexcept
+    {
+        jassert (isPositiveAndBelow (voice, maxVoices));
+        VoiceControls controls;
+
+        for (int control = 0; control < numControls; ++control)
+        {
+            controls.start[control] = starts[control][(size_t) voice];
+            controls.end[control] = ends[control][(size_t) voice];
+        }
+
+        return controls;
+    }
+
+    static constexpr float neutralValues[numControls] = { 0.0f, 0.0f, 0.5f };
+
+private:
+    /** Returns what a control should be for a note on the given channel (0 to 15). */
+    float getChannelValue (Control control, int channel) const noexcept
+    {
+        auto value = channelValues[channel][control];
+
+        if (control != pitchBend)
+            return value;
+
+        if (! mpeEnabled)
+            return value * masterBendRange;
+
+        // notes on the master channel only hear its bend, and the rest hear both
+        auto masterBend = channelValues[0][pitchBend] * masterBendRange;
+        return channel == 0 ? masterBend : masterBend + value * memberBendRange;
+    }
+
+    /** Maps a 7-bit value to 0 to 1, with 64 landing exactly in the middle, as MPE expects. */
+    static float getCentredValue (int value) noexcept
+    {
+        return value <= 64 ? (float) value / 128.0f : 0.5f + (float) (value - 64) / 126.0f;
+    }
+
+    void resetChannel (int channel) noexcept
+    {
+        std::copy (std::begin (neutralValues), std::end (neutralValues), channelValues[channel]);
+    }
+
+    void resetAllChannels() noexcept
+    {
+        for (int channel = 0; channel < 16; ++channel)
+            resetChannel (channel);
+    }
+
+    // how quickly the voices follow their controllers, which hides the steps between blocks
+    static constexpr double smoothingSeconds = 0.005;
+    static constexpr float snapThresholds[numControls] = { 0.001f, 0.0005f, 0.0005f };
+
+    const int maxVoices;
+    double sampleRate = 44100.0;
+    bool mpeEnabled = true;
+    float masterBendRange = 2.0f, memberBendRange = 48.0f;
+
+    float channelValues[16][numControls];
+    MidiBuffer remainingMidi;
+    size_t reservedMidiBytes = 0;
+    int64 numMessagesTaken = 0;
+
+    // one array per control, with an entry for each voice
+    std::vector<int> voiceChannels;
+    std::vector<float> targets[numControls], starts[numControls], ends[numControls];
+    std::vector<float> differences;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalExpression)
+};
@@ -0,0 +1,526 @@
+/*
+  ==============================================================================
+
+    A headless host that runs the independent branches of a processor graph
+    in parallel on a pool of worker threads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalRealtimeProfile.h"
+
+//==============================================================================
+/** Runs a set of processors connected as a directed acyclic graph, spreading
+    the ones that don't depend on each other across several threads.
+
+    Each node is usually a whole AudioProcessorGraph, such as a synth and its
+    chain of effects (see createChain()), which renders on one thread with the
+    graph's own delay compensation. Nodes can take their input from the sum of
+    other nodes, e.g. a master bus that mixes several chains together, and the
+    output is the sum of the nodes that nothing else takes input from.
+
+    Every node has a count of how many of its inputs are still to be rendered
+    in the current block. The nodes with no inputs are put on a ready list at
+    the start of a block, and when a node finishes, it counts down each of the
+    nodes that depend on it, adding any that reach zero to the list. The
+    workers and the calling thread all take nodes from the list until every
+    node has been rendered, so the caller never waits for a worker while there
+    is something it could be doing.
+
+    Each node's inputs are delayed so that they line up with the input with
+    the most latency, and the same is done for the output, so the host's
+    latency is that of its slowest path. The time each node takes is measured,
+    and getReport() sums it up.
+
+    Nodes must all be added before prepare() is called. After that, process()
+    doesn't allocate or take any locks.
+*/
+class ModalGraphHost
+{
+public:
+    /** Creates a host that renders on the calling thread plus this many minus one workers. */
+    explicit ModalGraphHost (int numThreadsToUse)
+    {
+        for (int i = 1; i < numThreadsToUse; ++i)
+            workers.add (new Worker (*this, i));
+    }
+
+    ~ModalGraphHost()
+    {
+        // the workers have to be stopped before the nodes they might be using are deleted
+        workers.clear();
+    }
+
+    int getNumThreads() const noexcept              { return workers.size() + 1; }
+
+    /** Gives the threads a real-time profile to set themselves up with. The
+        thread calling process() uses the profile's audio thread slot, and the
+        workers use the ones after it.
+    */
+    void setRealtimeProfile (ModalRealtimeProfile* profileToUse) noexcept   { realtimeProfile = profileToUse; }
+    int getNumNodes() const noexcept                { return nodes.size(); }
+
+    /** Adds a processor, whose input will be the sum of the given nodes' outputs,
+        and returns its index.
+    */
+    int addNode (std::unique_ptr<AudioProcessor> processor, const String& name, std::vector<int> inputs = {})
+    {
+        jassert (std::all_of (inputs.begin(), inputs.end(), [this] (int i) { return isPositiveAndBelow (i, nodes.size()); }));
+
+        auto* node = nodes.add (new Node());
+        node->processor = std::move (processor);
+        node->name = name;
+        node->inputs = std::move (inputs);
+        return nodes.size() - 1;
+    }
+
+    /** Returns the MIDI that a node will be given in the next block. It's cleared
+        once the node has been rendered.
+    */
+    MidiBuffer& getMidiBuffer (int nodeIndex) noexcept      { return nodes.getUnchecked (nodeIndex)->midi; }
+
+    //==============================================================================
+    /** Prepares all the processors, works out the order they depend on each
+        other in and the delays needed to line their outputs up, and starts the
+        workers.
+    */
+    void prepare (double newSampleRate, int newMaxBlockSize, int newNumOutputChannels)
+    {
+        sampleRate = newSampleRate;
+        maxBlockSize = jmax (1, newMaxBlockSize);
+        numOutputChannels = jmax (1, newNumOutputChannels);
+
+        for (auto* node : nodes)
+        {
+            node->processor->setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
+            node->processor->prepareToPlay (sampleRate, maxBlockSize);
+
+            auto numChannels = jmax (numOutputChannels, node->processor->getTotalNumInputChannels(),
+                                     node->processor->getTotalNumOutputChannels());
+            node->buffer.setSize (numChannels, maxBlockSize);
+            node->midi.ensureSize (midiBytesPerNode);
+            node->dependents.clear();
+        }
+
+        for (int i = 0; i < nodes.size(); ++i)
+            for (auto input : nodes.getUnchecked (i)->inputs)
+                nodes.getUnchecked (input)->dependents.push_back (i);
+
+        // the processors' latencies are only known once they've been prepared
+        for (auto i : getNodesInOrder())
+        {
+            auto& node = *nodes.getUnchecked (i);
+            auto latestInput = 0;
+
+            for (auto input : node.inputs)
+                latestInput = jmax (latestInput, nodes.getUnchecked (input)->pathLatency);
+
+            node.inputDelays.resize (node.inputs.size());
+
+            for (size_t j = 0; j < node.inputs.size(); ++j)
+            {
+                auto& input = *nodes.getUnchecked (node.inputs[j]);
+                auto delay = latestInput - input.pathLatency;
+                node.inputDelays[j].prepare (delay, jmin (input.buffer.getNumChannels(), node.buffer.getNumChannels()));
+                input.compensation = jmax (input.compensation, delay);
+            }
+
+            node.pathLatency = latestInput + node.processor->getLatencySamples();
+        }
+
+        outputs.clear();
+        latencySamples = 0;
+
+        for (int i = 0; i < nodes.size(); ++i)
+            if (nodes.getUnchecked (i)->dependents.empty())
+                latencySamples = jmax (latencySamples, nodes.getUnchecked (i)->pathLatency);
+
+        for (int i = 0; i < nodes.size(); ++i)
+        {
+            auto& node = *nodes.getUnchecked (i);
+
+            if (node.dependents.empty())
+            {
+                outputs.push_back ({ i, {} });
+                node.compensation = latencySamples - node.pathLatency;
+                outputs.back().delay.prepare (node.compensation, jmin (node.buffer.getNumChannels(), numOutputChannels));
+            }
+        }
+
+        readyNodes.reset (new std::atomic<Node*>[(size_t) jmax (1, nodes.size())]);
+        resetStats();
+
+        for (auto* worker : workers)
+            if (! worker->isThreadRunning())
+                worker->startThread();
+    }
+
+    void releaseResources()
+    {
+        for (auto* node : nodes)
+            node->processor->releaseResources();
+    }
+
+    /** Returns how many samples the output lags behind the MIDI, along the slowest path. */
+    int getLatencySamples() const noexcept          { return latencySamples; }
+
+    /** Renders every node for a block, and replaces the output with the sum of
+        the nodes at the end of the graph.
+    */
+    void process (AudioBuffer<float>& output, int numSamples) noexcept
+    {
+        jassert (numSamples <= maxBlockSize);
+
+        if (auto* profile = realtimeProfile.load())
+            profile->setUpCurrentThread (0);
+
+        auto startTime = Time::getHighResolutionTicks();
+
+        currentNumSamples = jmin (numSamples, maxBlockSize);
+        numReady = 0;
+        numCompleted = 0;
+
+        for (int i = 0; i < nodes.size(); ++i)
+        {
+            readyNodes[(size_t) i].store (nullptr, std::memory_order_relaxed);
+            nodes.getUnchecked (i)->numInputsPending = (int) nodes.getUnchecked (i)->inputs.size();
+        }
+
+        nextToTake = 0;
+
+        for (auto* node : nodes)
+            if (node->inputs.empty())
+                pushReadyNode (*node);
+
+        for (auto* worker : workers)
+            worker->wake.signal();
+
+        runReadyNodes();
+
+        // the last nodes may still be finishing on other threads
+        while (numCompleted.load() < nodes.size())
+            std::this_thread::yield();
+
+        output.clear (0, currentNumSamples);
+
+        for (auto& out : outputs)
+            out.delay.addDelayed (nodes.getUnchecked (out.node)->buffer, output, currentNumSamples);
+
+        auto seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTime);
+        auto load = seconds * sampleRate / currentNumSamples;
+        totalSeconds = totalSeconds.load() + seconds;
+        peakLoad = jmax (peakLoad.load(), load);
+        totalSamples += currentNumSamples;
+    }
+
+    //==============================================================================
+    void resetStats() noexcept
+    {
+        for (auto* node : nodes)
+        {
+            node->busySeconds = 0.0;
+            node->peakLoad = 0.0;
+        }
+
+        totalSeconds = 0.0;
+        peakLoad = 0.0;
+        totalSamples = 0;
+    }
+
+    /** Describes each node's latency and how much of a block's duration it took
+        to render, and how well the threads were kept busy.
+    */
+    String getReport() const
+    {
+        auto audioSeconds = (double) totalSamples.load() / sampleRate;
+
+        if (audioSeconds <= 0.0)
+            return "Nothing has been rendered\n";
+
+        auto percent = [] (double proportion) { return String (proportion * 100.0, 1) + "%"; };
+        String report;
+        double busySeconds = 0.0;
+
+        report << String ("node").paddedRight (' ', 20) << String ("latency").paddedLeft (' ', 9) << String ("path").paddedLeft (' ', 9)
+               << String ("delayed").paddedLeft (' ', 9) << String ("average").paddedLeft (' ', 10) << String ("peak").paddedLeft (' ', 10) << newLine;
+
+        for (auto* node : nodes)
+        {
+            busySeconds += node->busySeconds.load();
+
+            report << node->name.paddedRight (' ', 20)
+                   << String (node->processor->getLatencySamples()).paddedLeft (' ', 9)
+                   << String (node->pathLatency).paddedLeft (' ', 9)
+                   << String (node->compensation).paddedLeft (' ', 9)
+                   << percent (node->busySeconds.load() / audioSeconds).paddedLeft (' ', 10)
+                   << percent (node->peakLoad.load()).paddedLeft (' ', 10) << newLine;
+        }
+
+        auto wallSeconds = totalSeconds.load();
+
+        report << newLine
+               << "Rendered " << String (audioSeconds, 1) << " s in " << String (wallSeconds * 1000.0, 1) << " ms ("
+               << String (audioSeconds / wallSeconds, 1) << "x real time), average block " << percent (wallSeconds / audioSeconds)
+               << " of its duration, peak " << percent (peakLoad.load()) << newLine
+               << "Node CPU " << percent (busySeconds / audioSeconds) << " of one core, spread over "
+               << getNumThreads() << " threads at " << percent (busySeconds / (wallSeconds * getNumThreads())) << " utilisation" << newLine
+               << "Output latency " << latencySamples << " samples (" << String (latencySamples * 1000.0 / sampleRate, 2) << " ms)" << newLine;
+
+        return report;
+    }
+
+    //==============================================================================
+    /** Builds a graph that plays its MIDI through the first processor, and then
+        passes the audio through each of the others in turn. Its latency is the
+        sum of theirs once it's been prepared.
+    */
+    static std::unique_ptr<AudioProcessorGraph> createChain (std::vector<std::unique_ptr<AudioProcessor>> processors,
+                                                             int numChannels = 2)
+    {
+        jassert (! processors.empty());
+        using IOProcessor = AudioProcessorGraph::AudioGraphIOProcessor;
+
+        auto graph = std::make_unique<AudioProcessorGraph>();
+
+        // the graph's IO nodes take their channel counts from the graph, so it needs them before they're added
+        graph->setPlayConfigDetails (0, numChannels, 44100.0, 512);
+
+        auto previous = graph->addNode (std::make_unique<IOProcessor> (IOProcessor::midiInputNode))->nodeID;
+        auto isFirst = true;
+
+        for (auto& processor : processors)
+        {
+            auto node = graph->addNode (std::move (processor))->nodeID;
+
+            if (isFirst)
+                graph->addConnection ({ { previous, AudioProcessorGraph::midiChannelIndex }, { node, AudioProcessorGraph::midiChannelIndex } });
+            else
+                for (int channel = 0; channel < numChannels; ++channel)
+                    graph->addConnection ({ { previous, channel }, { node, channel } });
+
+            previous = node;
+            isFirst = false;
+        }
+
+        auto output = graph->addNode (std::make_unique<IOProcessor> (IOProcessor::audioOutputNode))->nodeID;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            graph->addConnection ({ { previous, channel }, { output, channel } });
+
+        return graph;
+    }
+
+private:
+    //==============================================================================
+    /** Delays a signal by a fixed number of samples while adding it to another. */
+    struct DelayLine
+    {
+        void prepare (int newLength, int numChannels)
+        {
+            buffer.setSize (numChannels, jmax (0, newLength));
+            buffer.clear();
+            position = 0;
+        }
+
+        void addDelayed (const AudioBuffer<float>& source, AudioBuffer<float>& destination, int numSamples) noexcept
+        {
+            auto length = buffer.getNumSamples();
+            auto numChannels = jmin (source.getNumChannels(), destination.getNumChannels());
+
+            if (length == 0)
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                    destination.addFrom (channel, 0, source, channel, 0, numSamples);
+
+                return;
+            }
+
+            for (int channel = 0; channel < jmin (numChannels, buffer.getNumChannels()); ++channel)
+            {
+                auto* line = buffer.getWritePointer (channel);
+                auto* in = source.getReadPointer (channel);
+                auto* out = destination.getWritePointer (channel);
+                auto p = position;
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    out[i] += line[p];
+                    line[p] = in[i];
+
+                    if (++p == length)
+                        p = 0;
+                }
+            }
+
+            position = (position + numSamples) % length;
+        }
+
+        AudioBuffer<float> buffer;
+        int position = 0;
+    };
+
+    struct Node
+    {
+        std::unique_ptr<AudioProcessor> processor;
+        String name;
+        std::vector<int> inputs, dependents;
+        std::vector<DelayLine> inputDelays;     // one for each input, lining it up with the latest
+        AudioBuffer<float> buffer;
+        MidiBuffer midi;
+
+        int pathLatency = 0;                    // the latency from the MIDI to this node's output
+        int compensation = 0;                   // the longest delay added to this node's output
+        std::atomic<int> numInputsPending { 0 };
+
+        // only written by the thread rendering the node, and read by anything
+        std::atomic<double> busySeconds { 0.0 }, peakLoad { 0.0 };
+    };
+
+    struct Output
+    {
+        int node;
+        DelayLine delay;
+    };
+
+    //==============================================================================
+    struct Worker final : public Thread
+    {
+        Worker (ModalGraphHost& hostToUse, int index)
+            : Thread ("Graph worker " + String (index)), host (hostToUse), slot (index)
+        {
+        }
+
+        ~Worker() override
+        {
+            signalThreadShouldExit();
+            wake.signal();
+            stopThread (2000);
+        }
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                wake.wait (-1.0);
+
+                if (threadShouldExit())
+                    break;
+
+                if (auto* profile = host.realtimeProfile.load())
+                    profile->setUpCurrentThread (slot);
+
+                host.runReadyNodes();
+            }
+        }
+
+        ModalGraphHost& host;
+        const int slot;
+        WaitableEvent wake;
+    };
+
+    //==============================================================================
+    /** Returns the nodes in an order where each comes after all of its inputs. */
+    std::vector<int> getNodesInOrder() const
+    {
+        std::vector<int> order, numPending;
+
+        for (auto* node : nodes)
+            numPending.push_back ((int) node->inputs.size());
+
+        for (int i = 0; i < nodes.size(); ++i)
+            if (numPending[(size_t) i] == 0)
+                order.push_back (i);
+
+        for (size_t i = 0; i < order.size(); ++i)
+            for (auto dependent : nodes.getUnchecked (order[i])->dependents)
+                if (--numPending[(size_t) dependent] == 0)
+                    order.push_back (dependent);
+
+        // if this fails, some of the nodes' inputs form a loop, and those nodes will never be rendered
+        jassert ((int) order.size() == nodes.size());
+        return order;
+    }
+
+    void pushReadyNode (Node& node) noexcept
+    {
+        readyNodes[(size_t) numReady++].store (&node, std::memory_order_release);
+    }
+
+    /** Takes nodes off the ready list and renders them until they've all been
+        taken. Slots are handed out in order, so a thread can take one that's
+        still empty, but only because a node that's being rendered will fill
+        it when it finishes.
+    */
+    void runReadyNodes() noexcept
+    {
+        auto numNodes = nodes.size();
+
+        for (auto index = nextToTake.load(); index < numNodes; index = nextToTake.load())
+        {
+            if (! nextToTake.compare_exchange_weak (index, index + 1))
+                continue;
+
+            Node* node;
+
+            while ((node = readyNodes[(size_t) index].load (std::memory_order_acquire)) == nullptr)
+                std::this_thread::yield();
+
+            renderNode (*node);
+        }
+    }
+
+    void renderNode (Node& node) noexcept
+    {
+        ScopedNoDenormals noDenormals;
+        auto startTime = Time::getHighResolutionTicks();
+        auto numSamples = currentNumSamples;
+
+        node.buffer.clear (0, numSamples);
+
+        for (size_t i = 0; i < node.inputs.size(); ++i)
+            node.inputDelays[i].addDelayed (nodes.getUnchecked (node.inputs[i])->buffer, node.buffer, numSamples);
+
+        // this refers to the node's own channels, so it doesn't allocate
+        AudioBuffer<float> block (node.buffer.getArrayOfWritePointers(), node.buffer.getNumChannels(), numSamples);
+        node.processor->processBlock (block, node.midi);
+        node.midi.clear();
+
+        auto seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTime);
+        node.busySeconds = node.busySeconds.load() + seconds;
+        node.peakLoad = jmax (node.peakLoad.load(), seconds * sampleRate / numSamples);
+
+        for (auto dependent : node.dependents)
+        {
+            auto& next = *nodes.getUnchecked (dependent);
+
+            if (--next.numInputsPending == 0)
+                pushReadyNode (next);
+        }
+
+        ++numCompleted;
+    }
+
+    //==============================================================================
+    static constexpr size_t midiBytesPerNode = 4096;
+
+    OwnedArray<Node> nodes;
+    std::vector<Output> outputs;
+    double sampleRate = 44100.0;
+    int maxBlockSize = 512, numOutputChannels = 2, latencySamples = 0;
+
+    // the current block's ready list, and how far through it the threads have got
+    std::unique_ptr<std::atomic<Node*>[]> readyNodes;
+    std::atomic<int> numReady { 0 }, nextToTake { 0 }, numCompleted { 0 };
+    int currentNumSamples = 0;
+
+    std::atomic<double> totalSeconds { 0.0 }, peakLoad { 0.0 };
+    std::atomic<int64> totalSamples { 0 };
+    std::atomic<ModalRealtimeProfile*> realtimeProfile { nullptr };
+
+    // declared last, so that the workers are stopped before anything they use is destroyed
+    OwnedArray<Worker> workers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalGraphHost)
+};
@@ -0,0 +1,249 @@
+/*
+  ==============================================================================
+
+    A keyboard state that the audio thread can update without taking a lock
+    or calling any listeners.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Keeps track of which notes are down, like MidiKeyboardState, but without
+    the audio thread ever waiting on the message thread.
+
+    MidiKeyboardState::processNextMidiBuffer() takes the state's lock and
+    calls every listener from the audio thread, so a keyboard component that
+    happens to be repainting holds up the audio. Here the audio thread only
+    sets and clears bits in an atomic bitmap, and picks up the notes played
+    from elsewhere from a lock-free FIFO. On the message thread, a timer
+    checks whether any bits have changed since it last looked, and if they
+    have, brings an ordinary MidiKeyboardState into line for the keyboard
+    component to show, however many notes changed in between.
+
+    Clicks on that component come back through its listener and go into the
+    FIFO, as do notes played with noteOn() and noteOff() from any thread.
+    Those are serialised with a spin lock between themselves, but the audio
+    thread only ever reads the FIFO, so it never waits for them.
+*/
+class ModalKeyboardState final : private MidiKeyboardState::Listener,
+                                 private Timer
+{
+public:
+    ModalKeyboardState()
+    {
+        displayState.addListener (this);
+        startTimerHz (30);
+    }
+
+    ~ModalKeyboardState() override
+    {
+        displayState.removeListener (this);
+    }
+
+    /** The state to give a MidiKeyboardComponent. Only use it on the message thread. */
+    MidiKeyboardState& getDisplayState() noexcept           { return displayState; }
+
+    //==============================================================================
+    /** Queues a note to be added to the next block. This can be called on any thread. */
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity)
+    {
+        push (MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity));
+    }
+
+    void noteOff (int midiChannel, int midiNoteNumber, float velocity)
+    {
+        push (MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity));
+    }
+
+    /** Releases every note on a channel, or on all of them if the channel is 0. */
+    void allNotesOff (int midiChannel)
+    {
+        for (int channel = 1; channel <= numChannels; ++channel)
+            if (midiChannel <= 0 || channel == midiChannel)
+                push (MidiMessage::allNotesOff (channel));
+    }
+
+    bool isNoteOn (int midiChannel, int midiNoteNumber) const noexcept
+    {
+        if (! isPositiveAndBelow (midiChannel - 1, numChannels) || ! isPositiveAndBelow (midiNoteNumber, 128))
+            return false;
+
+        auto bit = getBitIndex (midiChannel, midiNoteNumber);
+        return (noteBits[(size_t) (bit / 64)].load (std::memory_order_relaxed) & (uint64 (1) << (bit % 64))) != 0;
+    }
+
+    //==============================================================================
+    /** Notes which keys the buffer's messages press and release, and adds the
+        notes queued since the last block, spread across this one in the order
+        they were played. Call this on the audio thread; it doesn't lock,
+        allocate (as long as the buffer has room) or call anything else.
+    */
+    void processNextMidiBuffer (MidiBuffer& buffer, int startSample, int numSamples, bool injectQueuedEvents) noexcept
+    {
+        for (const auto metadata : buffer)
+            updateBits (metadata.getMessage());
+
+        if (! injectQueuedEvents)
+            return;
+
+        auto numReady = fifo.getNumReady();
+
+        if (numReady == 0)
+            return;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (numReady, start1, size1, start2, size2);
+
+        auto firstTime = queue[(size_t) start1].timeMs;
+        auto lastTime = queue[(size_t) (size2 > 0 ? start2 + size2 - 1 : start1 + size1 - 1)].timeMs;
+        auto scale = numSamples / (double) (lastTime + 1 - firstTime);
+
+        for (auto [start, size] : { std::make_pair (start1, size1), std::make_pair (start2, size2) })
+        {
+            for (int i = start; i < start + size; ++i)
+            {
+                auto& event = queue[(size_t) i];
+                auto message = event.getMessage();
+                auto position = jlimit (0, jmax (0, numSamples - 1), roundToInt ((event.timeMs - firstTime) * scale));
+
+                updateBits (message);
+                buffer.addEvent (message, startSample + position);
+            }
+        }
+
+        fifo.finishedRead (size1 + size2);
+    }
+
+    /** Returns how many queued notes have been lost because the FIFO was full. */
+    int getNumDroppedEvents() const noexcept                { return numDropped; }
+
+private:
+    //==============================================================================
+    /** A note message, small enough to go in the FIFO without allocating. */
+    struct QueuedEvent
+    {
+        uint8 bytes[3];
+        uint32 timeMs;
+
+        MidiMessage getMessage() const noexcept     { return MidiMessage (bytes[0], bytes[1], bytes[2]); }
+    };
+
+    static constexpr int numChannels = 16;
+    static constexpr int queueSize = 1024;
+
+    static int getBitIndex (int midiChannel, int midiNoteNumber) noexcept
+    {
+        return (midiChannel - 1) * 128 + midiNoteNumber;
+    }
+
+    void push (const MidiMessage& message)
+    {
+        const SpinLock::ScopedLockType sl (producerLock);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+        {
+            ++numDropped;
+            return;
+        }
+
+        auto& event = queue[(size_t) (size1 > 0 ? start1 : start2)];
+        auto* raw = message.getRawData();
+
+        for (int i = 0; i < 3; ++i)
+            event.bytes[i] = i < message.getRawDataSize() ? raw[i] : 0;
+
+        event.timeMs = Time::getMillisecondCounter();
+        fifo.finishedWrite (1);
+    }
+
+    void updateBits (const MidiMessage& message) noexcept
+    {
+        auto channel = message.getChannel();
+
+        if (! isPositiveAndBelow (channel - 1, numChannels))
+            return;
+
+        if (message.isNoteOn() || message.isNoteOff())
+        {
+            auto bit = getBitIndex (channel, message.getNoteNumber());
+            auto mask = uint64 (1) << (bit % 64);
+            auto& word = noteBits[(size_t) (bit / 64)];
+
+            if (message.isNoteOn())
+                word.fetch_or (mask, std::memory_order_relaxed);
+            else
+                word.fetch_and (~mask, std::memory_order_relaxed);
+        }
+        else if (message.isAllNotesOff() || message.isAllSoundOff())
+        {
+            auto bit = getBitIndex (channel, 0);
+
+            // each channel's 128 notes are exactly two words
+            noteBits[(size_t) (bit / 64)].store (0, std::memory_order_relaxed);
+            noteBits[(size_t) (bit / 64 + 1)].store (0, std::memory_order_relaxed);
+        }
+        else
+        {
+            return;
+        }
+
+        bitsChanged.store (true, std::memory_order_release);
+    }
+
+    //==============================================================================
+    void timerCallback() override
+    {
+        if (! bitsChanged.exchange (false, std::memory_order_acquire))
+            return;
+
+        // the display state's own listener would send these straight back to the FIFO
+        const ScopedValueSetter<bool> svs (isUpdatingDisplay, true);
+
+        for (int channel = 1; channel <= numChannels; ++channel)
+        {
+            for (int note = 0; note < 128; ++note)
+            {
+                auto isOn = isNoteOn (channel, note);
+
+                if (isOn != displayState.isNoteOn (channel, note))
+                {
+                    if (isOn)
+                        displayState.noteOn (channel, note, 1.0f);
+                    else
+                        displayState.noteOff (channel, note, 0.0f);
+                }
+            }
+        }
+    }
+
+    void handleNoteOn (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        if (! isUpdatingDisplay)
+            noteOn (midiChannel, midiNoteNumber, velocity);
+    }
+
+    void handleNoteOff (MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        if (! isUpdatingDisplay)
+            noteOff (midiChannel, midiNoteNumber, velocity);
+    }
+
+    //==============================================================================
+    std::array<std::atomic<uint64>, numChannels * 128 / 64> noteBits {};
+    std::atomic<bool> bitsChanged { false };
+
+    AbstractFifo fifo { queueSize };
+    std::array<QueuedEvent, queueSize> queue {};
+    SpinLock producerLock;
+    std::atomic<int> numDropped { 0 };
+
+    MidiKeyboardState displayState;
+    bool isUpdatingDisplay = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalKeyboardState)
+};
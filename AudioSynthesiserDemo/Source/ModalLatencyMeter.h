@@ -0,0 +1,601 @@
+/*
+  ==============================================================================
+
+    Measures the round-trip latency of an audio device with a test signal,
+    and the time from a MIDI note to the synth's first audible sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalAnalyser.h"
+
+//==============================================================================
+/** Sits at the end of an audio callback and measures latency in one of two ways.
+
+    For the round trip, it replaces the output with a test signal, either a
+    maximum length sequence or an exponential chirp, played once at the start
+    of each period and followed by silence. Whatever comes back on the first
+    input during the period is cross-correlated with the signal, and the lag
+    of the peak, interpolated to a fraction of a sample, is the time from a
+    sample being written to the output to it appearing in the input. Over
+    many periods, the spread of the lags is the jitter, and their slope
+    against time is the drift between the input and output clocks.
+
+    For MIDI to audio, it has a note played through the given function, as
+    the keyboard or a MIDI input would, and watches the output for the first
+    sample above a threshold. The latency is the wall-clock time from the
+    note being sent to that sample, plus the output latency that the device
+    reports, so it's only as accurate as the device's own figure. Each note
+    waits for the last one to die away first.
+
+    process() is called on the audio thread, and doesn't allocate or lock. The
+    correlation is done on the meter's own thread, and everything else should
+    be called on the message thread.
+*/
+class ModalLatencyMeter final : private Thread
+{
+public:
+    enum class Mode
+    {
+        off,
+        roundTrip,
+        midiToAudio
+    };
+
+    enum class Signal
+    {
+        mls,
+        chirp
+    };
+
+    /** The test signal is this long, and starts a period of twice this. */
+    static constexpr int signalOrder = 14;
+    static constexpr int signalLength = (1 << signalOrder) - 1;
+    static constexpr int periodLength = 1 << (signalOrder + 1);
+
+    /** The longest round trip that can be measured, in samples. */
+    static constexpr int maxLatencySamples = periodLength - signalLength;
+
+    //==============================================================================
+    ModalLatencyMeter()
+        : Thread ("Latency meter"),
+          fft (signalOrder + 2)
+    {
+        for (auto& capture : captures)
+            capture.assign ((size_t) periodLength, 0.0f);
+
+        real.assign ((size_t) fft.getSize(), 0.0f);
+        imag.assign ((size_t) fft.getSize(), 0.0f);
+    }
+
+    ~ModalLatencyMeter() override
+    {
+        stop();
+    }
+
+    /** Builds the test signals for a device's rate. Call this while the device
+        is stopped, e.g. from audioDeviceAboutToStart().
+    */
+    void prepare (double newSampleRate, int newOutputLatencySamples)
+    {
+        const ScopedLock sl (analysisLock);
+
+        sampleRate = newSampleRate;
+        outputLatencySamples = newOutputLatencySamples;
+
+        signals[(size_t) Signal::mls] = createMLS();
+        signals[(size_t) Signal::chirp] = createChirp (sampleRate);
+
+        for (size_t i = 0; i < signals.size(); ++i)
+            createSpectrum (signals[i], signalSpectra[i]);
+
+        position = 0;
+        runningMode = Mode::off;
+        filledCapture = -1;
+    }
+
+    /** Starts measuring, clearing any earlier results. For MIDI to audio, the
+        function is called on the meter's thread to start and stop a note.
+    */
+    void start (Mode newMode, Signal newSignal = Signal::mls, std::function<void (bool isNoteOn)> sendNoteToUse = {})
+    {
+        stop();
+
+        {
+            const ScopedLock sl (analysisLock);
+            roundTrips.clear();
+            midiLatencies.clear();
+            numRejected = 0;
+            numDropped = 0;
+        }
+
+        // a capture left over from the last run isn't part of this one
+        filledCapture = -1;
+
+        signal = newSignal;
+        sendNote = std::move (sendNoteToUse);
+        noteOffMs = Time::getMillisecondCounterHiRes();
+        quietSince = 0.0;
+        jassert (newMode != Mode::midiToAudio || sendNote != nullptr);
+
+        requestedMode = newMode;
+
+        if (newMode != Mode::off)
+            startThread();
+    }
+
+    void stop()
+    {
+        requestedMode = Mode::off;
+        stopThread (2000);
+
+        if (noteIsOn && sendNote != nullptr)
+            sendNote (false);
+
+        noteIsOn = false;
+    }
+
+    Mode getMode() const noexcept                   { return requestedMode; }
+
+    //==============================================================================
+    /** Plays the test signal or watches for notes. While measuring the round
+        trip, this replaces everything on the outputs.
+    */
+    void process (const float* const* inputs, int numInputs, float* const* outputs, int numOutputs, int numSamples) noexcept
+    {
+        // stopping takes effect straight away, and leaves the outputs alone
+        if (requestedMode.load() == Mode::off)
+        {
+            runningMode = Mode::off;
+            position = 0;
+            return;
+        }
+
+        for (int startSample = 0; startSample < numSamples;)
+        {
+            // any other change waits for the end of a period, so a capture is never half of each
+            if (position == 0)
+            {
+                runningMode = requestedMode.load();
+                runningSignal = signal.load();
+            }
+
+            auto mode = runningMode.load();
+
+            if (mode != Mode::roundTrip)
+            {
+                if (mode == Mode::midiToAudio)
+                    watchForNote (outputs, numOutputs, startSample, numSamples);
+
+                return;
+            }
+
+            startSample += processRoundTrip (inputs, numInputs, outputs, numOutputs, startSample, numSamples);
+        }
+    }
+
+    //==============================================================================
+    struct Summary
+    {
+        int count = 0;
+        double latest = 0.0, mean = 0.0, minimum = 0.0, maximum = 0.0, jitter = 0.0;
+    };
+
+    /** Sums up the round trips measured so far, in samples. */
+    Summary getRoundTripSummary() const
+    {
+        const ScopedLock sl (analysisLock);
+        std::vector<double> lags;
+
+        for (auto& roundTrip : roundTrips)
+            lags.push_back (roundTrip.lag);
+
+        return summarise (lags);
+    }
+
+    /** Sums up the MIDI to audio latencies measured so far, in milliseconds. */
+    Summary getMidiSummary() const
+    {
+        const ScopedLock sl (analysisLock);
+        return summarise (midiLatencies);
+    }
+
+    String getReport() const
+    {
+        const ScopedLock sl (analysisLock);
+        String report;
+
+        if (! roundTrips.empty())
+        {
+            auto summary = getRoundTripSummary();
+            auto ms = [this] (double samples) { return String (samples * 1000.0 / sampleRate, 2) + " ms"; };
+
+            report << "Round trip: " << String (summary.latest, 2) << " samples (" << ms (summary.latest) << "), mean "
+                   << String (summary.mean, 2) << ", range " << String (summary.minimum, 2) << " to " << String (summary.maximum, 2)
+                   << ", jitter " << String (summary.jitter, 3) << " samples over " << summary.count << " periods" << newLine
+                   << "Drift: " << String (getDriftPpm(), 2) << " ppm" << newLine;
+        }
+
+        if (! midiLatencies.empty())
+        {
+            auto summary = getMidiSummary();
+
+            report << "MIDI to first sample: " << String (summary.latest, 2) << " ms, mean " << String (summary.mean, 2)
+                   << ", range " << String (summary.minimum, 2) << " to " << String (summary.maximum, 2)
+                   << ", jitter " << String (summary.jitter, 2) << " ms over " << summary.count << " notes" << newLine;
+        }
+
+        if (numRejected > 0 || numDropped > 0)
+            report << numRejected << " periods with no clear peak, " << numDropped << " dropped" << newLine;
+
+        if (report.isEmpty())
+            report << (requestedMode.load() == Mode::off ? "Not measuring" : "Measuring...") << newLine;
+
+        return report;
+    }
+
+private:
+    //==============================================================================
+    struct RoundTrip
+    {
+        double seconds;     // when the period started, from the first one
+        double lag;
+    };
+
+    static constexpr float signalLevel = 0.25f;
+    static constexpr float onsetThreshold = 0.001f;         // -60 dB
+    static constexpr double quietSecondsBeforeNote = 0.1;
+    static constexpr double noteSeconds = 0.2, maxWaitSeconds = 5.0;
+
+    // a peak has to stand this far above the correlation's RMS to count
+    static constexpr double minPeakToRms = 8.0;
+    static constexpr size_t maxResults = 10000;
+
+    //==============================================================================
+    static std::vector<float> createMLS()
+    {
+        // x^14 + x^13 + x^12 + x^2 + 1, which steps through all 2^14 - 1 non-zero states
+        constexpr uint32 taps = 0x3802;
+        std::vector<float> sequence ((size_t) signalLength);
+        uint32 state = 1;
+
+        for (auto& sample : sequence)
+        {
+            auto bit = state & 1;
+            state >>= 1;
+
+            if (bit != 0)
+                state ^= taps;
+
+            sample = bit != 0 ? signalLevel : -signalLevel;
+        }
+
+        return sequence;
+    }
+
+    static std::vector<float> createChirp (double sampleRate)
+    {
+        std::vector<float> chirp ((size_t) signalLength);
+        auto startFrequency = 20.0, endFrequency = 0.45 * sampleRate;
+        auto duration = signalLength / sampleRate;
+        auto rate = std::log (endFrequency / startFrequency);
+        auto fadeLength = signalLength / 20;
+
+        for (int i = 0; i < signalLength; ++i)
+        {
+            auto t = i / sampleRate;
+            auto phase = MathConstants<double>::twoPi * startFrequency * duration / rate * (std::exp (t / duration * rate) - 1.0);
+            auto fade = jmin (1.0, jmin (i, signalLength - 1 - i) / (double) fadeLength);
+
+            chirp[(size_t) i] = (float) (signalLevel * std::sin (phase) * std::sin (fade * MathConstants<double>::halfPi));
+        }
+
+        return chirp;
+    }
+
+    void createSpectrum (const std::vector<float>& source, std::vector<float> (&spectrum)[2])
+    {
+        std::fill (real.begin(), real.end(), 0.0f);
+        std::fill (imag.begin(), imag.end(), 0.0f);
+        std::copy (source.begin(), source.end(), real.begin());
+
+        fft.perform (real.data(), imag.data());
+        spectrum[0] = real;
+        spectrum[1] = imag;
+    }
+
+    //==============================================================================
+    /** Plays and captures from the start sample up to the end of the block or
+        of the period, whichever comes first, and returns how many samples that was.
+    */
+    int processRoundTrip (const float* const* inputs, int numInputs, float* const* outputs, int numOutputs,
+                          int startSample, int numSamples) noexcept
+    {
+        auto& testSignal = signals[(size_t) runningSignal.load()];
+        auto* capture = captures[(size_t) writingCapture].data();
+        auto* input = numInputs > 0 ? inputs[0] : nullptr;
+
+        for (int i = startSample; i < numSamples; ++i)
+        {
+            auto sample = position < signalLength ? testSignal[(size_t) position] : 0.0f;
+
+            for (int channel = 0; channel < numOutputs; ++channel)
+                outputs[channel][i] = sample;
+
+            capture[position] = input != nullptr ? input[i] : 0.0f;
+
+            if (++position == periodLength)
+            {
+                position = 0;
+
+                // if the last capture hasn't been looked at yet, this one's lost
+                if (filledCapture.load() < 0)
+                {
+                    captureStarts[(size_t) writingCapture] = periodsStarted * periodLength;
+                    captureSignals[(size_t) writingCapture] = runningSignal.load();
+                    filledCapture = writingCapture;
+                    writingCapture ^= 1;
+                }
+                else
+                {
+                    ++numDropped;
+                }
+
+                ++periodsStarted;
+
+                // the caller checks for a change of mode before the next period starts
+                return i + 1 - startSample;
+            }
+        }
+
+        return numSamples - startSample;
+    }
+
+    /** Looks for the note's onset between the start sample and the end of the block. */
+    void watchForNote (float* const* outputs, int numOutputs, int startSample, int numSamples) noexcept
+    {
+        auto blockTimeMs = Time::getMillisecondCounterHiRes();
+        auto peak = 0.0f;
+        int onset = -1;
+
+        for (int i = startSample; i < numSamples; ++i)
+        {
+            for (int channel = 0; channel < numOutputs; ++channel)
+                peak = jmax (peak, std::abs (outputs[channel][i]));
+
+            if (onset < 0 && peak > onsetThreshold)
+                onset = i;
+        }
+
+        if (onset >= 0 && noteSentMs.load() > 0.0)
+        {
+            auto heardMs = blockTimeMs + (onset + outputLatencySamples) * 1000.0 / sampleRate;
+            onsetLatencyMs = heardMs - noteSentMs.load();
+            noteSentMs = 0.0;
+        }
+
+        quietSince = peak > onsetThreshold ? 0.0 : (quietSince.load() > 0.0 ? quietSince.load() : blockTimeMs);
+    }
+
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (requestedMode.load() == Mode::roundTrip)
+                analyseCapture();
+            else if (requestedMode.load() == Mode::midiToAudio)
+                measureNote();
+
+            wait (20);
+        }
+    }
+
+    void analyseCapture()
+    {
+        auto index = filledCapture.load();
+
+        if (index < 0)
+            return;
+
+        const ScopedLock sl (analysisLock);
+        auto& capture = captures[(size_t) index];
+
+        std::fill (real.begin(), real.end(), 0.0f);
+        std::fill (imag.begin(), imag.end(), 0.0f);
+        std::copy (capture.begin(), capture.end(), real.begin());
+        auto startSample = captureStarts[(size_t) index];
+        auto& spectrum = signalSpectra[(size_t) captureSignals[(size_t) index]];
+
+        // the capture can be reused as soon as it's been copied
+        filledCapture = -1;
+
+        fft.perform (real.data(), imag.data());
+
+        // multiplying by the conjugate of the signal's spectrum, and transforming the conjugate
+        // of that forwards again, gives the conjugate of the cross-correlation
+
+        for (size_t i = 0; i < real.size(); ++i)
+        {
+            auto r = real[i] * spectrum[0][i] + imag[i] * spectrum[1][i];
+            auto im = imag[i] * spectrum[0][i] - real[i] * spectrum[1][i];
+            real[i] = r;
+            imag[i] = -im;
+        }
+
+        fft.perform (real.data(), imag.data());
+
+        int peakIndex = 0;
+        double sumOfSquares = 0.0;
+
+        for (int i = 0; i < maxLatencySamples; ++i)
+        {
+            sumOfSquares += (double) real[(size_t) i] * real[(size_t) i];
+
+            if (std::abs (real[(size_t) i]) > std::abs (real[(size_t) peakIndex]))
+                peakIndex = i;
+        }
+
+        auto rms = std::sqrt (sumOfSquares / maxLatencySamples);
+        auto peak = std::abs ((double) real[(size_t) peakIndex]);
+
+        if (peak < rms * minPeakToRms || peak == 0.0)
+        {
+            ++numRejected;
+            return;
+        }
+
+        // fits a parabola through the peak and its neighbours
+        auto lag = (double) peakIndex;
+
+        if (peakIndex > 0 && peakIndex < maxLatencySamples - 1)
+        {
+            auto before = std::abs ((double) real[(size_t) peakIndex - 1]);
+            auto after  = std::abs ((double) real[(size_t) peakIndex + 1]);
+            auto curve = before - 2.0 * peak + after;
+
+            if (curve < 0.0)
+                lag += 0.5 * (before - after) / curve;
+        }
+
+        if (roundTrips.size() < maxResults)
+            roundTrips.push_back ({ (double) startSample / sampleRate, lag });
+    }
+
+    void measureNote()
+    {
+        auto now = Time::getMillisecondCounterHiRes();
+
+        if (noteIsOn)
+        {
+            auto latency = onsetLatencyMs.exchange (-1.0);
+
+            if (latency >= 0.0)
+            {
+                const ScopedLock sl (analysisLock);
+
+                if (midiLatencies.size() < maxResults)
+                    midiLatencies.push_back (latency);
+            }
+
+            // the note's let go of once it's been heard, or if it never is
+            if (latency >= 0.0 || now - noteOnMs > noteSeconds * 1000.0 + maxWaitSeconds * 1000.0)
+            {
+                if (latency < 0.0)
+                {
+                    const ScopedLock sl (analysisLock);
+                    ++numRejected;
+                }
+
+                noteSentMs = 0.0;
+                sendNote (false);
+                noteIsOn = false;
+                noteOffMs = now;
+            }
+
+            return;
+        }
+
+        auto quiet = quietSince.load();
+        auto waitedTooLong = now - noteOffMs > maxWaitSeconds * 1000.0;
+
+        // the last note has to have died away, or it would be heard as the next one's onset
+        if ((quiet > 0.0 && now - quiet > quietSecondsBeforeNote * 1000.0) || waitedTooLong)
+        {
+            onsetLatencyMs = -1.0;
+            noteOnMs = Time::getMillisecondCounterHiRes();
+            noteSentMs = noteOnMs;
+            sendNote (true);
+            noteIsOn = true;
+        }
+    }
+
+    //==============================================================================
+    static Summary summarise (const std::vector<double>& values)
+    {
+        Summary summary;
+
+        if (values.empty())
+            return summary;
+
+        summary.count = (int) values.size();
+        summary.latest = values.back();
+        summary.minimum = *std::min_element (values.begin(), values.end());
+        summary.maximum = *std::max_element (values.begin(), values.end());
+        summary.mean = std::accumulate (values.begin(), values.end(), 0.0) / (double) values.size();
+
+        double sumOfSquares = 0.0;
+
+        for (auto value : values)
+            sumOfSquares += (value - summary.mean) * (value - summary.mean);
+
+        summary.jitter = std::sqrt (sumOfSquares / (double) values.size());
+        return summary;
+    }
+
+    /** Fits a line to the lags against time. A slope of one sample per second
+        is a drift of one part in the sample rate.
+    */
+    double getDriftPpm() const
+    {
+        if (roundTrips.size() < 2)
+            return 0.0;
+
+        double meanTime = 0.0, meanLag = 0.0;
+
+        for (auto& roundTrip : roundTrips)
+        {
+            meanTime += roundTrip.seconds;
+            meanLag += roundTrip.lag;
+        }
+
+        meanTime /= (double) roundTrips.size();
+        meanLag /= (double) roundTrips.size();
+
+        double covariance = 0.0, variance = 0.0;
+
+        for (auto& roundTrip : roundTrips)
+        {
+            covariance += (roundTrip.seconds - meanTime) * (roundTrip.lag - meanLag);
+            variance += (roundTrip.seconds - meanTime) * (roundTrip.seconds - meanTime);
+        }
+
+        return variance > 0.0 ? covariance / variance / sampleRate * 1.0e6 : 0.0;
+    }
+
+    //==============================================================================
+    ModalAnalyser::FFT fft;
+    double sampleRate = 48000.0;
+    int outputLatencySamples = 0;
+
+    std::atomic<Mode> requestedMode { Mode::off }, runningMode { Mode::off };
+    std::atomic<Signal> signal { Signal::mls }, runningSignal { Signal::mls };
+
+    // only rebuilt in prepare(), while the audio thread isn't running
+    std::array<std::vector<float>, 2> signals;
+    std::vector<float> signalSpectra[2][2];
+
+    // the audio thread fills one capture while the meter's thread looks at the other
+    std::array<std::vector<float>, 2> captures;
+    std::array<int64, 2> captureStarts {};
+    std::array<Signal, 2> captureSignals {};      // what each capture was played with
+    std::atomic<int> filledCapture { -1 };
+    int writingCapture = 0, position = 0;
+    int64 periodsStarted = 0;
+
+    // for MIDI to audio, all in milliseconds on the high-resolution counter
+    std::function<void (bool)> sendNote;
+    std::atomic<double> noteSentMs { 0.0 }, onsetLatencyMs { -1.0 }, quietSince { 0.0 };
+    double noteOnMs = 0.0, noteOffMs = 0.0;
+    bool noteIsOn = false;
+
+    CriticalSection analysisLock;
+    std::vector<float> real, imag;
+    std::vector<RoundTrip> roundTrips;
+    std::vector<double> midiLatencies;
+    std::atomic<int> numRejected { 0 }, numDropped { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalLatencyMeter)
+};
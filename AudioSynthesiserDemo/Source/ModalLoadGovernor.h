@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    Trades timbral detail for CPU time when the audio callback gets close to
+    its deadline.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Watches how long each block takes to render compared to the time that
+    block represents, and steps through a few levels of reduced quality when
+    the load gets too high.
+
+    The level goes up quickly when the load crosses the upper threshold, but
+    only comes back down after the load has stayed under the lower threshold
+    for a while, so that it doesn't flap around near the limit.
+
+    update() must be called from the audio thread once per block; the getters
+    can be used from any thread.
+*/
+class ModalLoadGovernor
+{
+public:
+    ModalLoadGovernor() = default;
+
+    /** The settings used at one level of degradation. */
+    struct Quality
+    {
+        float modeProportion;      // fraction of each voice's modes that are rendered
+        float quietModeLevelDb;    // modes quieter than this are skipped
+        float voiceProportion;     // fraction of the voices that can start new notes
+        bool sympatheticStrings;   // whether the sympathetic strings are run at all
+    };
+
+    static constexpr int numLevels = 5;
+
+    void prepare (double sampleRate, int blockSize)
+    {
+        loadMeasurer.reset (sampleRate, blockSize);
+        level = 0;
+        blocksAtThisLevel = 0;
+        blocksPerSecond = jmax (1, roundToInt (sampleRate / jmax (1, blockSize)));
+    }
+
+    /** Use this to time the rendering of each block. */
+    AudioProcessLoadMeasurer& getLoadMeasurer() noexcept    { return loadMeasurer; }
+
+    /** Picks the quality level for the next block, based on the load so far. */
+    void update() noexcept
+    {
+        auto load = loadMeasurer.getLoadAsProportion();
+        auto current = level.load();
+        ++blocksAtThisLevel;
+
+        if (load > degradeAbove && current < numLevels - 1 && blocksAtThisLevel >= 2)
+            setLevel (current + 1);
+        else if (load < restoreBelow && current > 0 && blocksAtThisLevel >= blocksPerSecond)
+            setLevel (current - 1);
+    }
+
+    /** Returns 0 when running at full quality, up to numLevels - 1. */
+    int getLevel() const noexcept                { return level; }
+
+    /** Returns the smoothed proportion of each block's time spent rendering. */
+    double getLoad() const                       { return loadMeasurer.getLoadAsProportion(); }
+
+    Quality getQuality() const noexcept
+    {
+        static constexpr Quality levels[numLevels] = { { 1.0f,  -300.0f, 1.0f,  true  },
+                                                       { 0.8f,  -100.0f, 1.0f,  true  },
+                                                       { 0.6f,  -80.0f,  0.75f, false },
+                                                       { 0.4f,  -70.0f,  0.5f,  false },
+                                                       { 0.25f, -60.0f,  0.25f, false } };
+        return levels[level.load()];
+    }
+
+private:
+    void setLevel (int newLevel) noexcept
+    {
+        level = newLevel;
+        blocksAtThisLevel = 0;
+    }
+
+    AudioProcessLoadMeasurer loadMeasurer;
+    std::atomic<int> level { 0 };
+    int blocksAtThisLevel = 0, blocksPerSecond = 100;
+
+    const double degradeAbove = 0.8, restoreBelow = 0.5;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalLoadGovernor)
+};
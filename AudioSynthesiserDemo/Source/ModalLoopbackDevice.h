@@ -0,0 +1,444 @@
+/*
+  ==============================================================================
+
+    A software audio device that runs the callbacks on its own thread,
+    either in real time or as fast as possible, and feeds its output back to
+    its input.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** An audio device with no hardware behind it, so that the demo's callbacks
+    can be timed and tested on a machine with no sound card.
+
+    Its thread calls the callback once per block, either paced by the
+    high-resolution clock like a real device or back to back as fast as the
+    callback allows. The inputs hear the outputs one block plus a
+    configurable latency later, as if each output were plugged into the
+    matching input, so round trips can be measured through it. The start of
+    the output is captured, and the time each callback takes is recorded.
+
+    In the as-fast-as-possible mode, the host time given to the callback is
+    worked out from the sample position rather than read from the clock, so
+    a run renders the same thing every time.
+*/
+class ModalLoopbackDevice final : public AudioIODevice,
+                                  private Thread
+{
+public:
+    struct Settings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        int numInputChannels = 2, numOutputChannels = 2;
+        bool realTime = true;               // false to call back as fast as possible
+        int latencySamples = 0;             // the extra delay between an output and the input it reaches
+        double captureSeconds = 10.0;       // how much of the output is kept
+    };
+
+    //==============================================================================
+    /** What happened to the callbacks since the device was started. */
+    struct Stats
+    {
+        static constexpr int numHistogramBins = 20;     // in 10% steps of the block's duration
+
+        int64 numCallbacks = 0, numSamples = 0;
+        double wallSeconds = 0.0, callbackSeconds = 0.0, maxCallbackSeconds = 0.0;
+        double totalLatenessSeconds = 0.0, maxLatenessSeconds = 0.0;
+        int numOverruns = 0;
+        std::array<int64, numHistogramBins> histogram {};
+
+        String getReport (double sampleRate) const
+        {
+            if (numCallbacks == 0)
+                return "No callbacks\n";
+
+            auto blockSeconds = (double) numSamples / (double) numCallbacks / sampleRate;
+            auto audioSeconds = (double) numSamples / sampleRate;
+            auto percent = [blockSeconds] (double seconds) { return String (seconds / blockSeconds * 100.0, 1) + "%"; };
+            String report;
+
+            report << numCallbacks << " callbacks, " << String (audioSeconds, 2) << " s of audio in " << String (wallSeconds, 2)
+                   << " s (" << String (audioSeconds / jmax (1.0e-9, wallSeconds), 1) << "x real time)" << newLine
+                   << "Callback time: average " << percent (callbackSeconds / (double) numCallbacks)
+                   << ", peak " << percent (maxCallbackSeconds) << " of the block" << newLine
+                   << "Late starts: average " << String (totalLatenessSeconds / (double) numCallbacks * 1.0e6, 1)
+                   << " us, worst " << String (maxLatenessSeconds * 1.0e6, 1) << " us, " << numOverruns << " overruns" << newLine
+                   << "Callback time histogram:" << newLine;
+
+            auto largest = *std::max_element (histogram.begin(), histogram.end());
+
+            for (int i = 0; i < numHistogramBins; ++i)
+            {
+                if (histogram[(size_t) i] == 0)
+                    continue;
+
+                report << (i == numHistogramBins - 1 ? String (">=") + String (i * 10) : String (i * 10) + "-" + String ((i + 1) * 10)).paddedLeft (' ', 8)
+                       << "% " << String (histogram[(size_t) i]).paddedLeft (' ', 9) << " "
+                       << String::repeatedString ("#", (int) (histogram[(size_t) i] * 40 / jmax ((int64) 1, largest))) << newLine;
+            }
+
+            return report;
+        }
+    };
+
+    //==============================================================================
+    ModalLoopbackDevice (const String& deviceName, const Settings& settingsToUse)
+        : AudioIODevice (deviceName, loopbackTypeName),
+          Thread ("Loopback audio"),
+          settings (settingsToUse)
+    {
+    }
+
+    ~ModalLoopbackDevice() override
+    {
+        close();
+    }
+
+    static constexpr const char* loopbackTypeName = "Loopback";
+
+    //==============================================================================
+    StringArray getOutputChannelNames() override        { return getChannelNames ("Output", settings.numOutputChannels); }
+    StringArray getInputChannelNames() override         { return getChannelNames ("Input", settings.numInputChannels); }
+
+    Array<double> getAvailableSampleRates() override
+    {
+        Array<double> rates { 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+        rates.addIfNotAlreadyThere (settings.sampleRate);
+        rates.sort();
+        return rates;
+    }
+
+    Array<int> getAvailableBufferSizes() override
+    {
+        Array<int> sizes;
+
+        for (int size = 16; size <= 4096; size *= 2)
+            sizes.add (size);
+
+        sizes.addIfNotAlreadyThere (settings.blockSize);
+        sizes.sort();
+        return sizes;
+    }
+
+    int getDefaultBufferSize() override                 { return settings.blockSize; }
+
+    String open (const BigInteger& inputChannels, const BigInteger& outputChannels,
+                 double sampleRate, int bufferSizeSamples) override
+    {
+        close();
+
+        currentSampleRate = sampleRate > 0.0 ? sampleRate : settings.sampleRate;
+        currentBlockSize = bufferSizeSamples > 0 ? bufferSizeSamples : settings.blockSize;
+
+        activeInputs.clear();
+        activeOutputs.clear();
+
+        for (int i = 0; i < settings.numInputChannels; ++i)
+            if (inputChannels[i])
+                activeInputs.setBit (i);
+
+        for (int i = 0; i < settings.numOutputChannels; ++i)
+            if (outputChannels[i])
+                activeOutputs.setBit (i);
+
+        numActiveInputs = activeInputs.countNumberOfSetBits();
+        numActiveOutputs = activeOutputs.countNumberOfSetBits();
+
+        inputs.setSize (jmax (1, numActiveInputs), currentBlockSize);
+        outputs.setSize (jmax (1, numActiveOutputs), currentBlockSize);
+
+        // the outputs go round a ring, and the inputs read it back a block and the latency later
+        loopback.setSize (settings.numOutputChannels, currentBlockSize * 2 + jmax (0, settings.latencySamples));
+        loopback.clear();
+
+        capture.setSize (jmax (1, numActiveOutputs), jmax (1, roundToInt (settings.captureSeconds * currentSampleRate)));
+        capture.clear();
+
+        isDeviceOpen = true;
+        return {};
+    }
+
+    void close() override
+    {
+        stop();
+        isDeviceOpen = false;
+    }
+
+    bool isOpen() override                              { return isDeviceOpen; }
+
+    void start (AudioIODeviceCallback* newCallback) override
+    {
+        if (! isDeviceOpen || newCallback == nullptr)
+            return;
+
+        stop();
+
+        stats = {};
+        samplePosition = 0;
+        numCaptured = 0;
+        loopback.clear();
+
+        newCallback->audioDeviceAboutToStart (this);
+        callback = newCallback;
+        startThread();
+    }
+
+    void stop() override
+    {
+        if (callback == nullptr)
+            return;
+
+        stopThread (5000);
+
+        auto* oldCallback = callback;
+        callback = nullptr;
+        oldCallback->audioDeviceStopped();
+    }
+
+    bool isPlaying() override                           { return callback != nullptr; }
+    String getLastError() override                      { return {}; }
+
+    int getCurrentBufferSizeSamples() override          { return currentBlockSize; }
+    double getCurrentSampleRate() override              { return currentSampleRate; }
+    int getCurrentBitDepth() override                   { return 32; }
+    BigInteger getActiveOutputChannels() const override { return activeOutputs; }
+    BigInteger getActiveInputChannels() const override  { return activeInputs; }
+    int getOutputLatencyInSamples() override            { return jmax (0, settings.latencySamples); }
+    int getInputLatencyInSamples() override             { return 0; }
+    int getXRunCount() const noexcept override          { return stats.numOverruns; }
+
+    //==============================================================================
+    /** Returns the timings so far. This should only be called once the device has been stopped. */
+    const Stats& getStats() const noexcept
+    {
+        jassert (callback == nullptr);
+        return stats;
+    }
+
+    /** Returns the start of the output, as much as has been captured. This
+        should only be called once the device has been stopped.
+    */
+    const AudioBuffer<float>& getCapturedOutput() const noexcept
+    {
+        jassert (callback == nullptr);
+        return capture;
+    }
+
+    int getNumCapturedSamples() const noexcept          { return numCaptured; }
+    int getCaptureLength() const noexcept               { return capture.getNumSamples(); }
+    bool isRealTime() const noexcept                    { return settings.realTime; }
+
+private:
+    //==============================================================================
+    static StringArray getChannelNames (const String& prefix, int numChannels)
+    {
+        StringArray names;
+
+        for (int i = 0; i < numChannels; ++i)
+            names.add (prefix + " " + String (i + 1));
+
+        return names;
+    }
+
+    void run() override
+    {
+        auto blockSeconds = currentBlockSize / currentSampleRate;
+        auto blockTicks = Time::secondsToHighResolutionTicks (blockSeconds);
+        auto startTicks = Time::getHighResolutionTicks();
+        auto deadline = startTicks;
+
+        while (! threadShouldExit())
+        {
+            if (settings.realTime)
+            {
+                waitUntil (deadline);
+
+                if (threadShouldExit())
+                    break;
+            }
+
+            auto callbackStart = Time::getHighResolutionTicks();
+            auto lateness = settings.realTime ? Time::highResolutionTicksToSeconds (jmax ((int64) 0, callbackStart - deadline)) : 0.0;
+
+            // in real time, the host time is when the block was due; otherwise it's worked out from the position
+            uint64 hostTimeNs = settings.realTime ? (uint64) (Time::highResolutionTicksToSeconds (deadline) * 1.0e9)
+                                                  : (uint64) ((double) samplePosition * 1.0e9 / currentSampleRate);
+            AudioIODeviceCallbackContext context;
+            context.hostTimeNs = &hostTimeNs;
+
+            readLoopback();
+            outputs.clear();
+
+            callback->audioDeviceIOCallbackWithContext (inputs.getArrayOfReadPointers(), numActiveInputs,
+                                                        outputs.getArrayOfWritePointers(), numActiveOutputs,
+                                                        currentBlockSize, context);
+
+            auto callbackEnd = Time::getHighResolutionTicks();
+            writeLoopback();
+            captureOutput();
+            samplePosition += currentBlockSize;
+
+            auto callbackSeconds = Time::highResolutionTicksToSeconds (callbackEnd - callbackStart);
+            auto bin = jlimit (0, Stats::numHistogramBins - 1, (int) (callbackSeconds / blockSeconds * 10.0));
+
+            ++stats.numCallbacks;
+            stats.numSamples += currentBlockSize;
+            stats.callbackSeconds += callbackSeconds;
+            stats.maxCallbackSeconds = jmax (stats.maxCallbackSeconds, callbackSeconds);
+            stats.totalLatenessSeconds += lateness;
+            stats.maxLatenessSeconds = jmax (stats.maxLatenessSeconds, lateness);
+            ++stats.histogram[(size_t) bin];
+            stats.wallSeconds = Time::highResolutionTicksToSeconds (callbackEnd - startTicks);
+
+            deadline += blockTicks;
+
+            // a real device that missed its slot would drop the block and start again from now
+            if (settings.realTime && callbackEnd > deadline)
+            {
+                ++stats.numOverruns;
+                deadline = callbackEnd;
+            }
+        }
+    }
+
+    /** Sleeps until shortly before the deadline, and then spins up to it,
+        since sleeps are only accurate to a millisecond or so.
+    */
+    void waitUntil (int64 deadline)
+    {
+        for (;;)
+        {
+            auto remaining = Time::highResolutionTicksToSeconds (deadline - Time::getHighResolutionTicks());
+
+            if (remaining <= 0.0 || threadShouldExit())
+                return;
+
+            if (remaining > 0.002)
+                wait ((int) ((remaining - 0.0015) * 1000.0));
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void readLoopback() noexcept
+    {
+        auto length = loopback.getNumSamples();
+        auto delay = currentBlockSize + jmax (0, settings.latencySamples);
+        auto readPosition = (int) ((samplePosition - delay + (int64) length * 4) % length);
+        int input = 0;
+
+        inputs.clear();
+
+        for (int channel = 0; channel < settings.numInputChannels; ++channel)
+        {
+            if (! activeInputs[channel])
+                continue;
+
+            if (channel < loopback.getNumChannels())
+                copyFromRing (loopback, channel, readPosition, inputs.getWritePointer (input), currentBlockSize);
+
+            ++input;
+        }
+    }
+
+    void writeLoopback() noexcept
+    {
+        auto length = loopback.getNumSamples();
+        auto writePosition = (int) (samplePosition % length);
+        int output = 0;
+
+        for (int channel = 0; channel < loopback.getNumChannels(); ++channel)
+        {
+            if (! activeOutputs[channel])
+                continue;
+
+            auto* source = outputs.getReadPointer (output++);
+            auto first = jmin (currentBlockSize, length - writePosition);
+
+            loopback.copyFrom (channel, writePosition, source, first);
+            loopback.copyFrom (channel, 0, source + first, currentBlockSize - first);
+        }
+    }
+
+    static void copyFromRing (const AudioBuffer<float>& ring, int channel, int position, float* destination, int numSamples) noexcept
+    {
+        auto first = jmin (numSamples, ring.getNumSamples() - position);
+
+        FloatVectorOperations::copy (destination, ring.getReadPointer (channel, position), first);
+        FloatVectorOperations::copy (destination + first, ring.getReadPointer (channel), numSamples - first);
+    }
+
+    void captureOutput() noexcept
+    {
+        auto numToCopy = jmin (currentBlockSize, capture.getNumSamples() - numCaptured);
+
+        if (numToCopy <= 0)
+            return;
+
+        for (int channel = 0; channel < jmin (numActiveOutputs, capture.getNumChannels()); ++channel)
+            capture.copyFrom (channel, numCaptured, outputs, channel, 0, numToCopy);
+
+        numCaptured += numToCopy;
+    }
+
+    //==============================================================================
+    const Settings settings;
+    double currentSampleRate = 48000.0;
+    int currentBlockSize = 256;
+    BigInteger activeInputs, activeOutputs;
+    int numActiveInputs = 0, numActiveOutputs = 0;
+    bool isDeviceOpen = false;
+
+    AudioIODeviceCallback* callback = nullptr;
+    AudioBuffer<float> inputs, outputs, loopback, capture;
+    int64 samplePosition = 0;
+    std::atomic<int> numCaptured { 0 };
+    Stats stats;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalLoopbackDevice)
+};
+
+//==============================================================================
+/** Offers a single loopback device with the given settings, so that it can
+    be added to an AudioDeviceManager and selected like any other type.
+*/
+class ModalLoopbackDeviceType final : public AudioIODeviceType
+{
+public:
+    explicit ModalLoopbackDeviceType (const ModalLoopbackDevice::Settings& settingsToUse)
+        : AudioIODeviceType (ModalLoopbackDevice::loopbackTypeName), settings (settingsToUse)
+    {
+    }
+
+    static constexpr const char* deviceName = "Loopback";
+
+    void scanForDevices() override                                      {}
+    StringArray getDeviceNames (bool) const override                    { return { deviceName }; }
+    int getDefaultDeviceIndex (bool) const override                     { return 0; }
+    bool hasSeparateInputsAndOutputs() const override                   { return false; }
+
+    int getIndexOfDevice (AudioIODevice* device, bool) const override
+    {
+        return dynamic_cast<ModalLoopbackDevice*> (device) != nullptr ? 0 : -1;
+    }
+
+    AudioIODevice* createDevice (const String& outputDeviceName, const String& inputDeviceName) override
+    {
+        if (outputDeviceName.isNotEmpty() && outputDeviceName != deviceName)
+            return nullptr;
+
+        if (inputDeviceName.isNotEmpty() && inputDeviceName != deviceName)
+            return nullptr;
+
+        return new ModalLoopbackDevice (deviceName, settings);
+    }
+
+private:
+    const ModalLoopbackDevice::Settings settings;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalLoopbackDeviceType)
+};
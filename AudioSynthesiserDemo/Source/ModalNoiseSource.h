@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    Counter-based white noise, for exciting the modal voice continuously.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** A white noise generator where each sample is a hash of its own index.
+
+    There's no state carried from one sample to the next apart from the
+    counter, so a block is rendered by a plain loop over independent integer
+    operations that the compiler vectorises. Each voice owns one of these with
+    its own seed, so voices never share or contend for a random source.
+*/
+class ModalNoiseSource
+{
+public:
+    explicit ModalNoiseSource (uint32 seed = 0) noexcept     { setSeed (seed); }
+
+    /** Chooses which of the generator's streams to play. Different seeds give
+        unrelated sequences.
+    */
+    void setSeed (uint32 seed) noexcept
+    {
+        key = hash (seed ^ 0x6a09e667u);
+        counter = 0;
+    }
+
+    /** Starts the current stream again from the beginning. */
+    void reset() noexcept                                   { counter = 0; }
+
+    /** Fills a block with noise between -1 and 1. */
+    void render (float* output, int numSamples) noexcept
+    {
+        auto start = counter;
+
+        for (int i = 0; i < numSamples; ++i)
+            output[i] = toBipolar (hash ((start + (uint32) i) * 0x9e3779b9u + key));
+
+        counter += (uint32) numSamples;
+    }
+
+    //==============================================================================
+    /** A 32-bit integer mixer (Chris Wellons' "lowbias32"), which turns
+        consecutive integers into values that pass the usual statistical tests.
+    */
+    static uint32 hash (uint32 x) noexcept
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static float toBipolar (uint32 bits) noexcept           { return (float) (int32) bits * (1.0f / 2147483648.0f); }
+
+private:
+    uint32 key = 0, counter = 0;
+};
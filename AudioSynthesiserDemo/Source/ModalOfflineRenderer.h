@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    Renders the modal voice outside of the audio callback, for the headless
+    export and analysis tools.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AudioSynthesiserDemo.h"
+
+//==============================================================================
+/** The parameters that fully determine the sound of a single modal note. */
+struct ModalNoteSettings
+{
+    int midiNote = 60;
+    float velocity = 1.0f;
+    float stiffness = 0.0f;
+    float pluckPos = 0.2f;
+    float pickupPos = 0.3f;
+};
+
+//==============================================================================
+/** Owns a single SineWaveVoice and its own mode tables, so that several
+    renderers can run on different threads without sharing any state.
+*/
+class OfflineModalRenderer
+{
+public:
+    OfflineModalRenderer (double sampleRateToUse, int numChannelsToUse = 1, int blockSizeToUse = 512)
+        : sampleRate (sampleRateToUse),
+          blockSize (blockSizeToUse),
+          buffer (numChannelsToUse, blockSizeToUse)
+    {
+        voice = std::make_unique<SineWaveVoice>();
+        voice->setModeTables (&modeTables);
+        voice->setCurrentPlaybackSampleRate (sampleRate);
+        voice->setKernelVariant (ModalRenderKernels::detectVariant());
+        voice->setMaximumBlockSize (blockSize);
+    }
+
+    /** Called with each rendered block; return false to abort the render. */
+    using BlockConsumer = std::function<bool (const AudioBuffer<float>&, int numSamples)>;
+
+    /** Plays a note and renders it until it has decayed below the given
+        threshold, or until maxSeconds have been rendered.
+
+        If startSample is non-zero, the note is moved directly to that position
+        before rendering begins, and the time before it isn't rendered at all.
+        The end of the note is also worked out from its mode amplitudes, so
+        no time is wasted rendering a silent tail.
+
+        Returns the number of samples rendered, or -1 if the consumer aborted.
+    */
+    int renderUntilSilent (const ModalNoteSettings& note, float silenceThresholdDb,
+                           double maxSeconds, const BlockConsumer& consumeBlock,
+                           int64 startSample = 0)
+    {
+        startNote (note);
+        voice->seek (startSample);
+
+        auto threshold = Decibels::decibelsToGain (silenceThresholdDb);
+        auto numToRender = jmin ((int64) (maxSeconds * sampleRate), voice->getSamplesUntilSilent (threshold));
+
+        auto numRendered = renderBlocks ((int) numToRender, consumeBlock);
+        voice->stopNote (0.0f, false);
+        return numRendered;
+    }
+
+    /** Renders a fixed section of a note, starting at the given position. */
+    int renderRange (const ModalNoteSettings& note, int64 startSample, int numSamples,
+                     const BlockConsumer& consumeBlock)
+    {
+        startNote (note);
+        voice->seek (startSample);
+
+        auto numRendered = renderBlocks (numSamples, consumeBlock);
+        voice->stopNote (0.0f, false);
+        return numRendered;
+    }
+
+    /** By default the renderer runs with flush-to-zero enabled, and the voice
+        flushes modes that have decayed away. These can be turned off to
+        measure what they're saving.
+    */
+    void setDenormalProtection (bool shouldUseFlushToZero, bool shouldFlushDecayedModes)
+    {
+        useFlushToZero = shouldUseFlushToZero;
+        voice->setFlushDecayedModes (shouldFlushDecayedModes);
+    }
+
+    void setStereoWidth (float width)                           { voice->setStereoWidth (width); }
+    void setPrecision (SineWaveVoice::Precision precision)      { voice->setPrecision (precision); }
+    void setSineAccuracy (ModalSineKernel::Accuracy accuracy)   { voice->setSineAccuracy (accuracy); }
+    void setKernelVariant (ModalRenderKernels::Variant variant) { voice->setKernelVariant (variant); }
+
+    double getSampleRate() const noexcept       { return sampleRate; }
+    int getNumChannels() const noexcept         { return buffer.getNumChannels(); }
+
+private:
+    void startNote (const ModalNoteSettings& note)
+    {
+        auto* table = modeTables.get();
+
+        if (table == nullptr || table->preset.stiffness != note.stiffness
+             || table->preset.pluckPos != note.pluckPos || table->preset.pickupPositions[0] != note.pickupPos)
+        {
+            ModalPreset preset;
+            preset.stiffness = note.stiffness;
+            preset.pluckPos = note.pluckPos;
+            preset.pickupPositions[0] = note.pickupPos;
+            modeTables.publish (std::make_unique<ModeTable> (preset, sampleRate));
+        }
+
+        voice->startNote (note.midiNote, note.velocity, nullptr, 8192);
+    }
+
+    int renderBlocks (int numSamples, const BlockConsumer& consumeBlock)
+    {
+        std::optional<ScopedNoDenormals> noDenormals;
+
+        if (useFlushToZero)
+            noDenormals.emplace();
+
+        for (int numRendered = 0; numRendered < numSamples;)
+        {
+            auto numThisTime = jmin (blockSize, numSamples - numRendered);
+
+            buffer.clear();
+            voice->renderNextBlock (buffer, 0, numThisTime);
+            numRendered += numThisTime;
+
+            if (! consumeBlock (buffer, numThisTime))
+                return -1;
+        }
+
+        return numSamples;
+    }
+
+    double sampleRate;
+    int blockSize;
+    AudioBuffer<float> buffer;
+    bool useFlushToZero = true;
+
+    SnapshotPublisher<ModeTable> modeTables;
+    std::unique_ptr<SineWaveVoice> voice;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OfflineModalRenderer)
+};
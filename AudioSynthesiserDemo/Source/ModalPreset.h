@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    The settings that make up a patch for the modal string, and the built-in
+    set of them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalRenderKernels.h"
+
+//==============================================================================
+/** Everything that determines the sound of the string, apart from the note
+    being played. A ModeTable is built from one of these, so switching patch
+    is just a matter of publishing a new table.
+*/
+struct ModalPreset
+{
+    static constexpr int numModes = 50;
+    static constexpr int maxPickups = ModalRenderKernels::maxPickups;
+
+    String name { "Default" };
+    float stiffness = 0.0f;
+    float pluckPos = 0.2f;
+    float pickupPositions[maxPickups] = { 0.3f, 1.1f, 1.9f, 2.7f };
+    float decay = 0.001f;               // the decay rate of every mode
+    float decayHighFreq = 0.001f;       // extra decay, growing with the square of the mode number
+
+    /** The presets that the app starts with. */
+    static const std::vector<ModalPreset>& getFactoryPresets()
+    {
+        static const std::vector<ModalPreset> presets
+        {
+            { "Default",              0.0f,  0.2f,  { 0.3f,  1.1f, 1.9f, 2.7f }, 0.001f,  0.001f   },
+            { "Bright, near bridge",  0.02f, 0.08f, { 0.12f, 0.2f, 1.9f, 2.7f }, 0.001f,  0.0005f  },
+            { "Mellow, mid string",   0.0f,  1.3f,  { 1.5f,  0.9f, 1.9f, 2.7f }, 0.001f,  0.003f   },
+            { "Muted",                0.0f,  0.3f,  { 0.4f,  1.1f, 1.9f, 2.7f }, 0.01f,   0.01f    },
+            { "Stiff wire",           0.6f,  0.15f, { 0.3f,  0.7f, 1.9f, 2.7f }, 0.0005f, 0.0005f  },
+            { "Metal bar",            1.6f,  0.5f,  { 0.25f, 1.3f, 1.9f, 2.7f }, 0.0002f, 0.0002f  },
+        };
+
+        return presets;
+    }
+};
+
+//==============================================================================
+/** The per-mode description of a patch, independent of the note and sample
+    rate. It can be worked out from a ModalPreset's settings, or come from
+    analysing a recording, in which case it needn't follow the ideal string
+    model at all.
+
+    It's a plain block of floats, so that a bank file can hold it exactly as
+    it's laid out in memory.
+*/
+struct ModalPresetModes
+{
+    static constexpr int numModes = ModalPreset::numModes;
+    static constexpr int maxPickups = ModalPreset::maxPickups;
+
+    ModalPresetModes() = default;
+
+    explicit ModalPresetModes (const ModalPreset& preset) noexcept
+    {
+        setFrequenciesAndDampings (preset);
+        setAmplitudes (preset);
+        setPickupWeights (preset);
+    }
+
+    /** Works out the modes of an ideal stiff string with frequency-dependent damping. */
+    void setFrequenciesAndDampings (const ModalPreset& preset) noexcept
+    {
+        auto stiffness = preset.stiffness;
+
+        for (int i = 0; i < numModes; i++)
+        {
+            int myMode = i + 1;
+            float myModeSquared = myMode * myMode;
+            float sig = preset.decay + (preset.decayHighFreq * myModeSquared);
+            float w0 = myMode * sqrtf(1.0f + (stiffness * stiffness) * myModeSquared);
+            frequencyRatios[i] = w0 * sqrtf(1.0f - ((sig * sig) / (w0 * w0)));
+            dampings[i] = sig;
+        }
+    }
+
+    /** Works out how strongly a pluck at the preset's position excites each mode. */
+    void setAmplitudes (const ModalPreset& preset) noexcept
+    {
+        for (int i = 0; i < numModes; i++)
+        {
+            int n = i + 1;
+            amplitudes[i] = (float) (2.0 * sin (preset.pluckPos * n) / ((n * n) * preset.pluckPos * (MathConstants<double>::pi - preset.pluckPos)));
+        }
+    }
+
+    /** Works out how much each of the preset's pickups hears each mode. */
+    void setPickupWeights (const ModalPreset& preset) noexcept
+    {
+        for (int pickup = 0; pickup < maxPickups; ++pickup)
+            for (int i = 0; i < numModes; i++)
+                pickupWeights[pickup][i] = sin ((i + 1) * preset.pickupPositions[pickup]);
+    }
+
+    /** Returns a hash of every value, so that two sets of modes that came from
+        the same settings, but not from the same analysis, can be told apart.
+    */
+    uint64 getHash() const noexcept
+    {
+        // FNV-1a over the floats exactly as they're laid out, with no padding in between
+        auto* bytes = reinterpret_cast<const uint8*> (this);
+        uint64 hash = 0xcbf29ce484222325ull;
+
+        for (size_t i = 0; i < sizeof (*this); ++i)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+        return hash;
+    }
+
+    float frequencyRatios[numModes] = {};               // each mode's frequency relative to the fundamental
+    float dampings[numModes] = {};                      // each mode's decay rate, relative to its frequency
+    float amplitudes[numModes] = {};                    // each mode's starting amplitude
+    float pickupWeights[maxPickups][numModes] = {};     // how much each pickup hears each mode
+};
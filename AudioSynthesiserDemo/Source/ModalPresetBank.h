@@ -0,0 +1,459 @@
+/*
+  ==============================================================================
+
+    A binary file format for large banks of modal presets, which is mapped
+    into memory and used in place rather than being read and parsed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModeTable.h"
+
+//==============================================================================
+/** A read-only bank of presets, loaded from a memory-mapped file.
+
+    Opening a bank only reads its header and index, so its cost grows with
+    the number of presets but not with their size, and only the pages
+    holding the presets that are actually used are ever read from disk. Each
+    preset has its own checksum in the index, which is checked when it's
+    first used.
+
+    The layout of a file is:
+
+        Header      (64 bytes)
+        Index       (one 64-byte IndexEntry per preset)
+        Records     (one Record per preset, each starting on a 16-byte boundary)
+
+    All values are little-endian. The header records the number of modes and
+    pickups the bank was made for, and a bank is only opened by a build with
+    the same numbers, so that its records can be used directly as structs.
+*/
+class ModalPresetBank
+{
+public:
+    static constexpr uint32 fileMagic = 0x4b42504d;    // "MPBK"
+    static constexpr uint32 formatVersion = 1;
+    static constexpr int maxNameLength = 47;
+
+    struct Header
+    {
+        uint32 magic, version, byteOrderMark, headerChecksum;
+        uint32 numPresets, numModes, maxPickups, recordSize;
+        uint64 indexOffset, recordsOffset;
+        uint32 indexChecksum, reserved[3];
+    };
+
+    struct IndexEntry
+    {
+        char name[maxNameLength + 1];       // UTF-8, padded with zeros
+        uint64 recordOffset;
+        uint32 recordChecksum, reserved;
+    };
+
+    /** A preset's settings, followed by its modes. */
+    struct Record
+    {
+        float stiffness, pluckPos, decay, decayHighFreq;
+        float pickupPositions[ModalPreset::maxPickups];
+        ModalPresetModes modes;
+    };
+
+    static_assert (sizeof (Header) == 64 && sizeof (IndexEntry) == 64, "The bank format depends on these sizes");
+    static_assert (std::is_trivially_copyable_v<Record>, "Records are used straight from the file");
+
+    /** Holds one preset on its way into a new bank. */
+    struct Entry
+    {
+        ModalPreset preset;
+        ModalPresetModes modes;
+    };
+
+    //==============================================================================
+    ModalPresetBank() = default;
+
+    /** Maps a bank file and checks its header and index. Any bank that was
+        already open is closed first.
+    */
+    Result open (const File& file)
+    {
+        close();
+
+        if (ByteOrder::isBigEndian())
+            return Result::fail ("Preset banks can't be used on big-endian machines");
+
+        auto mapped = std::make_unique<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+        auto* data = static_cast<const char*> (mapped->getData());
+        auto size = mapped->getSize();
+
+        if (data == nullptr || size < sizeof (Header))
+            return Result::fail ("Couldn't map " + file.getFullPathName());
+
+        auto& h = *reinterpret_cast<const Header*> (data);
+
+        if (h.magic != fileMagic || h.byteOrderMark != byteOrderMark)
+            return Result::fail (file.getFileName() + " isn't a preset bank");
+
+        if (h.version != formatVersion)
+            return Result::fail (file.getFileName() + " is version " + String (h.version) + " of the bank format, but only version "
+                                  + String (formatVersion) + " can be read");
+
+        if (h.headerChecksum != getHeaderChecksum (h))
+            return Result::fail (file.getFileName() + " has a damaged header");
+
+        if (h.numModes != (uint32) ModalPreset::numModes || h.maxPickups != (uint32) ModalPreset::maxPickups
+             || h.recordSize != (uint32) getRecordSize())
+            return Result::fail (file.getFileName() + " was made for a different number of modes or pickups");
+
+        auto indexSize = (uint64) h.numPresets * sizeof (IndexEntry);
+        auto recordsSize = (uint64) h.numPresets * h.recordSize;
+
+        // the offsets come from the file, so they're compared in a way that can't wrap around
+        auto fits = [size] (uint64 offset, uint64 length) { return offset <= size && length <= size - offset; };
+
+        if (h.indexOffset % 16 != 0 || ! fits (h.indexOffset, indexSize) || ! fits (h.recordsOffset, recordsSize))
+            return Result::fail (file.getFileName() + " is truncated");
+
+        auto* entries = reinterpret_cast<const IndexEntry*> (data + h.indexOffset);
+
+        if (h.indexChecksum != checksum (entries, (size_t) indexSize))
+            return Result::fail (file.getFileName() + " has a damaged index");
+
+        for (uint32 i = 0; i < h.numPresets; ++i)
+            if (entries[i].recordOffset % 16 != 0 || ! fits (entries[i].recordOffset, sizeof (Record)))
+                return Result::fail (file.getFileName() + " has an index entry that points outside the file");
+
+        mappedFile = std::move (mapped);
+        header = &h;
+        index = entries;
+        verified.assign (h.numPresets, false);
+        return Result::ok();
+    }
+
+    void close()
+    {
+        header = nullptr;
+        index = nullptr;
+        verified.clear();
+        mappedFile.reset();
+    }
+
+    bool isOpen() const noexcept                    { return header != nullptr; }
+    int getNumPresets() const noexcept              { return isOpen() ? (int) header->numPresets : 0; }
+    size_t getFileSize() const noexcept             { return mappedFile != nullptr ? mappedFile->getSize() : 0; }
+
+    String getName (int presetIndex) const
+    {
+        auto& name = getIndexEntry (presetIndex).name;
+        return String::fromUTF8 (name, (int) strnlen (name, sizeof (name)));
+    }
+
+    /** Returns a preset straight from the mapped file, without copying it. The
+        pointer stays valid until the bank is closed.
+    */
+    const Record& getRecord (int presetIndex) const noexcept
+    {
+        auto* data = static_cast<const char*> (mappedFile->getData());
+        return *reinterpret_cast<const Record*> (data + getIndexEntry (presetIndex).recordOffset);
+    }
+
+    /** Checks a preset against its checksum. Each one is only checked once. */
+    bool verifyPreset (int presetIndex)
+    {
+        if (verified[(size_t) presetIndex])
+            return true;
+
+        auto ok = checksum (&getRecord (presetIndex), sizeof (Record)) == getIndexEntry (presetIndex).recordChecksum;
+        verified[(size_t) presetIndex] = ok;
+        return ok;
+    }
+
+    /** Returns a preset's settings and modes, or nothing if it's damaged. */
+    std::optional<Entry> getPreset (int presetIndex)
+    {
+        if (! verifyPreset (presetIndex))
+            return {};
+
+        auto& record = getRecord (presetIndex);
+        Entry entry { {}, record.modes };
+        entry.preset.name = getName (presetIndex);
+        entry.preset.stiffness = record.stiffness;
+        entry.preset.pluckPos = record.pluckPos;
+        entry.preset.decay = record.decay;
+        entry.preset.decayHighFreq = record.decayHighFreq;
+        std::copy (std::begin (record.pickupPositions), std::end (record.pickupPositions), entry.preset.pickupPositions);
+        return entry;
+    }
+
+    //==============================================================================
+    /** Writes a new bank file, replacing any file that's already there. */
+    static Result write (const File& file, const std::vector<Entry>& entries)
+    {
+        Header h {};
+        h.magic = fileMagic;
+        h.version = formatVersion;
+        h.byteOrderMark = byteOrderMark;
+        h.numPresets = (uint32) entries.size();
+        h.numModes = (uint32) ModalPreset::numModes;
+        h.maxPickups = (uint32) ModalPreset::maxPickups;
+        h.recordSize = (uint32) getRecordSize();
+        h.indexOffset = sizeof (Header);
+        h.recordsOffset = h.indexOffset + entries.size() * sizeof (IndexEntry);
+
+        std::vector<IndexEntry> entriesToWrite (entries.size());
+        MemoryBlock records (entries.size() * getRecordSize(), true);
+
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            auto& preset = entries[i].preset;
+            auto& record = *reinterpret_cast<Record*> (static_cast<char*> (records.getData()) + i * getRecordSize());
+
+            record.stiffness = preset.stiffness;
+            record.pluckPos = preset.pluckPos;
+            record.decay = preset.decay;
+            record.decayHighFreq = preset.decayHighFreq;
+            std::copy (std::begin (preset.pickupPositions), std::end (preset.pickupPositions), record.pickupPositions);
+            record.modes = entries[i].modes;
+
+            auto& entry = entriesToWrite[i];
+            preset.name.copyToUTF8 (entry.name, sizeof (entry.name));
+            entry.recordOffset = h.recordsOffset + i * getRecordSize();
+            entry.recordChecksum = checksum (&record, sizeof (Record));
+        }
+
+        h.indexChecksum = checksum (entriesToWrite.data(), entriesToWrite.size() * sizeof (IndexEntry));
+        h.headerChecksum = getHeaderChecksum (h);
+
+        TemporaryFile temp (file);
+
+        {
+            FileOutputStream out (temp.getFile());
+
+            if (! out.openedOk())
+                return Result::fail ("Couldn't write to " + file.getFullPathName());
+
+            if (! (out.write (&h, sizeof (h))
+                    && out.write (entriesToWrite.data(), entriesToWrite.size() * sizeof (IndexEntry))
+                    && out.write (records.getData(), records.getSize())))
+                return Result::fail ("Couldn't write to " + file.getFullPathName());
+        }
+
+        if (! temp.overwriteTargetFileWithTemporary())
+            return Result::fail ("Couldn't replace " + file.getFullPathName());
+
+        return Result::ok();
+    }
+
+    //==============================================================================
+    /** Reads a list of presets from a JSON or XML file, for converting to a
+        bank. Either format holds a list of presets, each of which has a name
+        and any of the ModalPreset settings. A preset can also give any of its
+        modes' frequencyRatios, dampings, amplitudes and pickupWeights
+        directly, e.g. from an analysis; whatever it leaves out is worked out
+        from its settings.
+
+        JSON:   { "presets": [ { "name": "...", "stiffness": 0.1, "frequencyRatios": [ ... ],
+                                 "pickupWeights": [ [ ... ], [ ... ] ] } ] }
+
+        XML:    <PRESETS> <PRESET name="..." stiffness="0.1" frequencyRatios="1 2.01 ..."/> </PRESETS>
+    */
+    static Result readPresetList (const File& file, std::vector<Entry>& entries)
+    {
+        if (file.hasFileExtension ("xml"))
+        {
+            auto xml = XmlDocument::parse (file);
+
+            if (xml == nullptr)
+                return Result::fail ("Couldn't parse " + file.getFullPathName());
+
+            for (auto* child : xml->getChildWithTagNameIterator ("PRESET"))
+                entries.push_back (makeEntry ([child] (const char* name) -> var
+                {
+                    if (! child->hasAttribute (name))
+                        return {};
+
+                    auto text = child->getStringAttribute (name);
+
+                    if (! text.containsAnyOf (" ,;"))
+                        return text.getFloatValue();
+
+                    // lists of pickup weights are separated by semicolons, and their values by spaces or commas
+                    Array<var> lists;
+
+                    for (auto& list : StringArray::fromTokens (text, ";", {}))
+                    {
+                        Array<var> values;
+
+                        for (auto& token : StringArray::fromTokens (list, " ,", {}))
+                            if (token.isNotEmpty())
+                                values.add (token.getFloatValue());
+
+                        lists.add (values);
+                    }
+
+                    return lists.size() == 1 ? lists.getReference (0) : var (lists);
+                }, child->getStringAttribute ("name")));
+
+            return Result::ok();
+        }
+
+        var json;
+        auto result = JSON::parse (file.loadFileAsString(), json);
+
+        if (result.failed())
+            return result;
+
+        if (auto* presets = json["presets"].getArray())
+        {
+            for (auto& preset : *presets)
+                entries.push_back (makeEntry ([&preset] (const char* name) { return preset[name]; }, preset["name"].toString()));
+
+            return Result::ok();
+        }
+
+        return Result::fail (file.getFileName() + " doesn't have a list of presets");
+    }
+
+    /** Writes a list of presets as JSON, in the form that readPresetList() reads,
+        with every mode given explicitly.
+    */
+    static Result writePresetList (const File& file, const std::vector<Entry>& entries)
+    {
+        auto makeList = [] (const float* values, int numValues)
+        {
+            Array<var> list;
+
+            for (int i = 0; i < numValues; ++i)
+                list.add (values[i]);
+
+            return var (list);
+        };
+
+        Array<var> presets;
+
+        for (auto& entry : entries)
+        {
+            auto& preset = entry.preset;
+            auto& modes = entry.modes;
+            auto* object = new DynamicObject();
+
+            object->setProperty ("name", preset.name);
+            object->setProperty ("stiffness", preset.stiffness);
+            object->setProperty ("pluckPos", preset.pluckPos);
+            object->setProperty ("decay", preset.decay);
+            object->setProperty ("decayHighFreq", preset.decayHighFreq);
+            object->setProperty ("pickupPositions", makeList (preset.pickupPositions, ModalPreset::maxPickups));
+            object->setProperty ("frequencyRatios", makeList (modes.frequencyRatios, ModalPreset::numModes));
+            object->setProperty ("dampings", makeList (modes.dampings, ModalPreset::numModes));
+            object->setProperty ("amplitudes", makeList (modes.amplitudes, ModalPreset::numModes));
+
+            Array<var> pickupWeights;
+
+            for (auto& weights : modes.pickupWeights)
+                pickupWeights.add (makeList (weights, ModalPreset::numModes));
+
+            object->setProperty ("pickupWeights", pickupWeights);
+            presets.add (var (object));
+        }
+
+        auto* root = new DynamicObject();
+        root->setProperty ("presets", presets);
+
+        if (! file.replaceWithText (JSON::toString (var (root))))
+            return Result::fail ("Couldn't write " + file.getFullPathName());
+
+        return Result::ok();
+    }
+
+private:
+    static constexpr uint32 byteOrderMark = 0x01020304;
+
+    static constexpr size_t getRecordSize() noexcept     { return (sizeof (Record) + 15) & ~(size_t) 15; }
+
+    const IndexEntry& getIndexEntry (int presetIndex) const noexcept
+    {
+        jassert (isPositiveAndBelow (presetIndex, getNumPresets()));
+        return index[presetIndex];
+    }
+
+    /** 32-bit FNV-1a, which is quick and catches truncation and bit rot, though not deliberate tampering. */
+    static uint32 checksum (const void* data, size_t numBytes) noexcept
+    {
+        auto* bytes = static_cast<const uint8*> (data);
+        uint32 hash = 2166136261u;
+
+        for (size_t i = 0; i < numBytes; ++i)
+            hash = (hash ^ bytes[i]) * 16777619u;
+
+        return hash;
+    }
+
+    static uint32 getHeaderChecksum (Header h) noexcept
+    {
+        h.headerChecksum = 0;
+        return checksum (&h, sizeof (h));
+    }
+
+    /** Builds an entry from a preset's properties, looked up by name. */
+    template <typename GetProperty>
+    static Entry makeEntry (GetProperty&& getProperty, const String& name)
+    {
+        Entry entry;
+        auto& preset = entry.preset;
+        preset.name = name;
+
+        auto readFloat = [&] (const char* property, float& value)
+        {
+            auto v = getProperty (property);
+
+            if (! v.isVoid())
+                value = (float) v;
+        };
+
+        auto readList = [] (const var& list, float* values, int numValues)
+        {
+            if (auto* array = list.getArray())
+                for (int i = 0; i < jmin (numValues, array->size()); ++i)
+                    values[i] = (float) array->getReference (i);
+        };
+
+        readFloat ("stiffness", preset.stiffness);
+        readFloat ("pluckPos", preset.pluckPos);
+        readFloat ("decay", preset.decay);
+        readFloat ("decayHighFreq", preset.decayHighFreq);
+        readList (getProperty ("pickupPositions"), preset.pickupPositions, ModalPreset::maxPickups);
+
+        // anything given explicitly replaces what the string model would give
+        auto& modes = entry.modes;
+        modes = ModalPresetModes (preset);
+
+        readList (getProperty ("frequencyRatios"), modes.frequencyRatios, ModalPreset::numModes);
+        readList (getProperty ("dampings"), modes.dampings, ModalPreset::numModes);
+        readList (getProperty ("amplitudes"), modes.amplitudes, ModalPreset::numModes);
+
+        auto pickupWeights = getProperty ("pickupWeights");
+
+        if (auto* lists = pickupWeights.getArray(); lists != nullptr && ! lists->isEmpty())
+        {
+            if (lists->getReference (0).isArray())
+            {
+                for (int pickup = 0; pickup < jmin (ModalPreset::maxPickups, lists->size()); ++pickup)
+                    readList (lists->getReference (pickup), modes.pickupWeights[pickup], ModalPreset::numModes);
+            }
+            else
+            {
+                readList (pickupWeights, modes.pickupWeights[0], ModalPreset::numModes);
+            }
+        }
+
+        return entry;
+    }
+
+    std::unique_ptr<MemoryMappedFile> mappedFile;
+    const Header* header = nullptr;
+    const IndexEntry* index = nullptr;
+    std::vector<bool> verified;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalPresetBank)
+};
@@ -0,0 +1,372 @@
+/*
+  ==============================================================================
+
+    An opt-in real-time profile for the audio and worker threads: FIFO
+    scheduling, pinning to isolated cores, and locking and pre-faulting the
+    memory they use.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if JUCE_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+/** Keeps the scheduler and the pager out of the way of the audio callback.
+
+    When it's enabled, the whole process's memory is locked, so that nothing
+    the audio thread touches can be paged out, and the next time each of the
+    real-time threads calls setUpCurrentThread(), it's given the SCHED_FIFO
+    policy and pinned to one of the cores that the kernel has been told to
+    keep other tasks off (isolcpus), the audio thread getting the first.
+
+    Most of these need privileges that a desktop session may not have, so
+    each step that fails falls back to carrying on without it, and
+    getReport() says what was achieved and what wasn't. setUpCurrentThread()
+    only makes system calls once per change of settings, and doesn't
+    allocate, so it can be called at the top of every callback.
+
+    Only Linux is supported; elsewhere the report just says so.
+*/
+class ModalRealtimeProfile
+{
+public:
+    /** The number of threads whose set-up can be tracked. Slot 0 is the audio thread. */
+    static constexpr int maxThreads = 64;
+
+    ModalRealtimeProfile() = default;
+
+    ~ModalRealtimeProfile()
+    {
+        if (memoryLocked)
+            unlockMemory();
+    }
+
+    //==============================================================================
+    /** Turns the profile on or off. The threads pick up the change the next
+        time they call setUpCurrentThread(). Call this on the message thread.
+
+        The priority is the SCHED_FIFO one, from 1 to 99, and the cores are a
+        list like "2-3,6". If no cores are given, the kernel's isolated cores
+        are used, and if there aren't any, the threads aren't pinned.
+    */
+    void setEnabled (bool shouldBeEnabled, int priorityToUse = 70, const String& coreList = {})
+    {
+        priority = jlimit (1, 99, priorityToUse);
+        coresFromKernel = coreList.isEmpty();
+        setCores (parseCoreList (coresFromKernel ? readIsolatedCores() : coreList));
+
+        if (shouldBeEnabled != memoryLocked)
+        {
+            if (shouldBeEnabled)
+                lockMemory();
+            else
+                unlockMemory();
+        }
+
+        enabled = shouldBeEnabled;
+        ++settingsVersion;
+    }
+
+    bool isEnabled() const noexcept                 { return enabled; }
+
+    /** Applies the current settings to the calling thread if they've changed
+        since it last called this. Slot 0 is for the audio thread, and each
+        worker should use its own slot from 1 upwards.
+    */
+    void setUpCurrentThread (int slot) noexcept
+    {
+        if (! isPositiveAndBelow (slot, maxThreads))
+            return;
+
+        auto& thread = threads[(size_t) slot];
+        auto version = settingsVersion.load();
+
+        if (thread.appliedVersion.load() == version)
+            return;
+
+        if (enabled)
+        {
+            applyToCurrentThread (thread);
+            prefaultStack();
+        }
+        else if (thread.isPromoted)
+        {
+            restoreCurrentThread (thread);
+        }
+
+        thread.appliedVersion = version;
+    }
+
+    //==============================================================================
+    /** Touches every page of a block of memory, so that the first time the
+        audio thread uses it doesn't cost a page fault. The contents are left
+        as they are.
+    */
+    static void prefault (const void* data, size_t numBytes) noexcept
+    {
+        if (data == nullptr || numBytes == 0)
+            return;
+
+        auto* bytes = static_cast<volatile char*> (const_cast<void*> (data));
+
+        // writing is what makes the kernel give the page its own memory, rather
+        // than mapping the shared zero page for a read
+        for (size_t i = 0; i < numBytes; i += pageSize)
+            bytes[i] = bytes[i];
+
+        bytes[numBytes - 1] = bytes[numBytes - 1];
+    }
+
+    template <typename ElementType>
+    static void prefault (const std::vector<ElementType>& vector) noexcept
+    {
+        prefault (vector.data(), vector.capacity() * sizeof (ElementType));
+    }
+
+    //==============================================================================
+    /** Describes what the profile asked for, and what each thread that's
+        been set up actually got.
+    */
+    String getReport() const
+    {
+        String report;
+
+       #if JUCE_LINUX
+        if (! enabled)
+            return "Real-time profile off\n";
+
+        report << "Memory: " << (memoryLocked ? "locked" : "not locked (" + describeError (lockError) + "), pre-faulted only") << newLine;
+
+        if (numCores == 0)
+            report << "Cores: " << (coresFromKernel ? "no isolated cores, threads not pinned" : "none given, threads not pinned") << newLine;
+        else
+            report << "Cores: " << describeCores() << (coresFromKernel ? " (isolated)" : "") << newLine;
+
+        for (int slot = 0; slot < maxThreads; ++slot)
+        {
+            auto& thread = threads[(size_t) slot];
+
+            if (thread.appliedVersion.load() == 0)
+                continue;
+
+            report << (slot == 0 ? String ("Audio thread") : "Worker " + String (slot)) << ": ";
+
+            if (thread.scheduleError.load() == 0)
+                report << "SCHED_FIFO " << thread.priority.load();
+            else
+                report << "normal priority (SCHED_FIFO failed: " << describeError (thread.scheduleError.load()) << ")";
+
+            if (thread.core.load() >= 0)
+            {
+                report << ", ";
+
+                if (thread.affinityError.load() == 0)
+                    report << "on core " << thread.core.load();
+                else
+                    report << "not pinned to core " << thread.core.load() << " (" << describeError (thread.affinityError.load()) << ")";
+            }
+
+            report << newLine;
+        }
+       #else
+        report << "Real-time profile isn't supported on this platform\n";
+       #endif
+
+        return report;
+    }
+
+private:
+    //==============================================================================
+    struct ThreadState
+    {
+        std::atomic<uint32> appliedVersion { 0 };
+        std::atomic<int> priority { 0 }, core { -1 }, scheduleError { 0 }, affinityError { 0 };
+
+        // the core the thread should be pinned to, or -1; written by setCores() before the
+        // version is bumped, and read by the thread as a single value, so it can't be torn
+        std::atomic<int> requestedCore { -1 };
+
+        // what the thread had before it was promoted, e.g. the device's own real-time
+        // priority; only used by the thread itself
+        bool isPromoted = false;
+       #if JUCE_LINUX
+        int originalPolicy = SCHED_OTHER;
+        sched_param originalParam {};
+        cpu_set_t originalCores {};
+       #endif
+    };
+
+    static constexpr size_t pageSize = 4096;
+    static constexpr size_t stackBytesToPrefault = 64 * 1024;
+    static constexpr int maxCores = 256;
+
+    void applyToCurrentThread (ThreadState& thread) noexcept
+    {
+       #if JUCE_LINUX
+        if (! thread.isPromoted)
+        {
+            pthread_getschedparam (pthread_self(), &thread.originalPolicy, &thread.originalParam);
+            pthread_getaffinity_np (pthread_self(), sizeof (thread.originalCores), &thread.originalCores);
+            thread.isPromoted = true;
+        }
+
+        sched_param param {};
+        param.sched_priority = priority;
+        thread.priority = priority.load();
+        thread.scheduleError = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param);
+
+        auto core = thread.requestedCore.load();
+
+        if (core >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO (&set);
+            CPU_SET (core, &set);
+            thread.core = core;
+            thread.affinityError = pthread_setaffinity_np (pthread_self(), sizeof (set), &set);
+        }
+        else
+        {
+            thread.core = -1;
+            thread.affinityError = 0;
+        }
+       #else
+        ignoreUnused (thread);
+       #endif
+    }
+
+    static void restoreCurrentThread (ThreadState& thread) noexcept
+    {
+       #if JUCE_LINUX
+        pthread_setschedparam (pthread_self(), thread.originalPolicy, &thread.originalParam);
+        pthread_setaffinity_np (pthread_self(), sizeof (thread.originalCores), &thread.originalCores);
+       #endif
+
+        thread.isPromoted = false;
+
+        thread.priority = 0;
+        thread.core = -1;
+        thread.scheduleError = 0;
+        thread.affinityError = 0;
+    }
+
+    /** Grows the stack as far as a deep callback is likely to go, so that it
+        doesn't fault in new pages part-way through one.
+    */
+    static void prefaultStack() noexcept
+    {
+        char stack[stackBytesToPrefault];
+
+        // the writes go through a volatile pointer so that they aren't optimised away
+        auto* pages = static_cast<volatile char*> (stack);
+
+        for (size_t i = 0; i < stackBytesToPrefault; i += pageSize)
+            pages[i] = 0;
+    }
+
+    void lockMemory()
+    {
+       #if JUCE_LINUX
+        lockError = mlockall (MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : errno;
+        memoryLocked = (lockError == 0);
+       #endif
+    }
+
+    void unlockMemory()
+    {
+       #if JUCE_LINUX
+        munlockall();
+       #endif
+        memoryLocked = false;
+    }
+
+    //==============================================================================
+    static String readIsolatedCores()
+    {
+       #if JUCE_LINUX
+        return File ("/sys/devices/system/cpu/isolated").loadFileAsString().trim();
+       #else
+        return {};
+       #endif
+    }
+
+    /** Parses a list of cores in the kernel's format, e.g. "2-3,6". */
+    static Array<int> parseCoreList (const String& text)
+    {
+        Array<int> result;
+
+        for (auto& token : StringArray::fromTokens (text, ",", {}))
+        {
+            auto first = token.upToFirstOccurrenceOf ("-", false, false).trim();
+
+            if (! first.containsOnly ("0123456789") || first.isEmpty())
+                continue;
+
+            auto last = token.containsChar ('-') ? token.fromFirstOccurrenceOf ("-", false, false).trim().getIntValue()
+                                                 : first.getIntValue();
+
+            for (auto core = first.getIntValue(); core <= jmin (last, maxCores - 1); ++core)
+                result.addIfNotAlreadyThere (core);
+        }
+
+        return result;
+    }
+
+    void setCores (const Array<int>& newCores) noexcept
+    {
+        auto count = jmin (newCores.size(), (int) cores.size());
+
+        for (int i = 0; i < count; ++i)
+            cores[(size_t) i] = newCores.getUnchecked (i);
+
+        numCores = count;
+
+        for (int slot = 0; slot < maxThreads; ++slot)
+            threads[(size_t) slot].requestedCore = count > 0 ? cores[(size_t) (slot % count)] : -1;
+    }
+
+    String describeCores() const
+    {
+        StringArray list;
+
+        for (int i = 0; i < numCores; ++i)
+            list.add (String (cores[(size_t) i]));
+
+        return list.joinIntoString (",");
+    }
+
+    static String describeError (int error)
+    {
+        if (error == EPERM)
+            return "not permitted, needs CAP_SYS_NICE or an rtprio limit";
+
+        if (error == ENOMEM)
+            return "over the memlock limit";
+
+        return std::strerror (error);
+    }
+
+    //==============================================================================
+    std::atomic<bool> enabled { false };
+    std::atomic<int> priority { 70 };
+    std::atomic<uint32> settingsVersion { 1 };
+
+    // only used on the message thread; each thread is handed its own core through its ThreadState
+    std::array<int, maxCores> cores {};
+    int numCores = 0;
+    bool coresFromKernel = true;
+
+    bool memoryLocked = false;
+    int lockError = 0;
+
+    std::array<ThreadState, maxThreads> threads;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalRealtimeProfile)
+};
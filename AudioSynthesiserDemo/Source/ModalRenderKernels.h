@@ -0,0 +1,292 @@
+/*
+  ==============================================================================
+
+    The modal voice's inner render loop, built for several instruction sets
+    and chosen at run time to suit the CPU.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalSineKernel.h"
+
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define MODAL_KERNEL_DISPATCH 1
+#else
+ #define MODAL_KERNEL_DISPATCH 0
+#endif
+
+//==============================================================================
+/** The release build targets baseline SSE2, so the mode loop is compiled again
+    here with AVX2 and AVX-512 enabled, and the best one the CPU supports is
+    picked when playback is prepared. A single binary then runs everywhere and
+    still uses the wider registers where they exist.
+
+    The same inline loop is used for every variant; the compiler inlines it
+    into each of the target-specific wrappers and vectorises it for that
+    instruction set.
+*/
+namespace ModalRenderKernels
+{
+    enum class Variant
+    {
+        generic,    // whatever the project's compiler flags allow, SSE2 on x86-64
+        avx2,
+        avx512
+    };
+
+    inline const char* getVariantName (Variant variant) noexcept
+    {
+        switch (variant)
+        {
+            case Variant::avx2:     return "AVX2";
+            case Variant::avx512:   return "AVX-512";
+            case Variant::generic:  break;
+        }
+
+        return "generic";
+    }
+
+    /** Returns the fastest variant that this CPU can run. */
+    inline Variant detectVariant() noexcept
+    {
+       #if MODAL_KERNEL_DISPATCH
+        if (SystemStats::hasAVX512F())
+            return Variant::avx512;
+
+        if (SystemStats::hasAVX2() && SystemStats::hasFMA3())
+            return Variant::avx2;
+       #endif
+
+        return Variant::generic;
+    }
+
+    //==============================================================================
+    /** The most pickups a voice can have, each of which hears the modes with
+        its own set of weights.
+    */
+    static constexpr int maxPickups = 4;
+
+    /** The most weighted sums a bank can produce at once. There's room for two
+        sets of pickups, so that a voice can crossfade from one to the other.
+    */
+    static constexpr int maxOutputs = 2 * maxPickups;
+
+    /** Everything the render loop needs to know about a voice's modes. The
+        arrays must be padded to a multiple of the lane width, and numModes
+        must be a multiple of it too.
+    */
+    template <typename FloatType>
+    struct ModeBank
+    {
+        ModalSineKernel::Phase* phases;
+        const ModalSineKernel::Phase* phaseIncrements;
+        FloatType* amplitudes;
+        const FloatType* decayMultipliers;
+        const FloatType* outputWeights[maxOutputs];
+        FloatType* modeOutputs;     // somewhere to keep each mode's output for the current sample
+        int numModes, numPickups;
+        float gain;
+    };
+
+    /** Renders a block of output for each pickup from a bank of decaying modes.
+        The oscillators are only run once, however many pickups there are.
+    */
+    template <typename FloatType, bool compensated, ModalSineKernel::Accuracy accuracy>
+    forcedinline void renderModeBlock (float* const* outputs, int numSamples, const ModeBank<FloatType>& bank) noexcept
+    {
+        constexpr int laneWidth = ModalSineKernel::laneWidth;
+
+        auto* phases = bank.phases;
+        auto* amplitudes = bank.amplitudes;
+        auto* modeOutputs = bank.modeOutputs;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            for (int j = 0; j < bank.numModes; ++j)
+            {
+                modeOutputs[j] = ModalSineKernel::sine<accuracy> (phases[j]) * amplitudes[j];
+                phases[j] += bank.phaseIncrements[j];
+                amplitudes[j] *= bank.decayMultipliers[j];
+            }
+
+            for (int pickup = 0; pickup < bank.numPickups; ++pickup)
+            {
+                auto* weights = bank.outputWeights[pickup];
+
+                // each lane keeps its own running sum, so that the compiler is free to
+                // vectorise across the modes without changing the order of the additions
+                FloatType sums[laneWidth] = {}, compensations[laneWidth] = {};
+
+                for (int group = 0; group < bank.numModes; group += laneWidth)
+                {
+                    for (int lane = 0; lane < laneWidth; ++lane)
+                    {
+                        FloatType term = modeOutputs[group + lane] * weights[group + lane];
+
+                        if constexpr (compensated)
+                        {
+                            auto y = term - compensations[lane];
+                            auto t = sums[lane] + y;
+                            compensations[lane] = (t - sums[lane]) - y;
+                            sums[lane] = t;
+                        }
+                        else
+                        {
+                            sums[lane] += term;
+                        }
+                    }
+                }
+
+                FloatType sum = 0;
+
+                for (auto laneSum : sums)
+                    sum += laneSum;
+
+                outputs[pickup][i] = (float) (sum * bank.gain);
+            }
+        }
+    }
+
+    //==============================================================================
+    /** A bank of damped two-pole resonators, driven by an input signal. Each one
+        is held as a complex one-pole filter, z = p * z + g * x, whose imaginary
+        part is a decaying sinusoid at the pole's angle. This has the same poles
+        as a real biquad, but keeps its tuning accurate in float even for very
+        low frequencies and very long decays.
+    */
+    struct ResonatorBank
+    {
+        float* real;
+        float* imag;
+        const float* poleReal;          // r * cos (w)
+        const float* poleImag;          // r * sin (w)
+        const float* inputGains;
+        const float* outputWeights[maxOutputs];
+        float* modeOutputs;
+        int numResonators, numPickups;
+        float gain;
+    };
+
+    /** Runs a block of input through a bank of resonators, writing the
+        weighted sum of them to each of the outputs. A null input leaves the
+        resonators ringing on their own.
+    */
+    forcedinline void renderResonatorBlock (const float* input, float* const* outputs, int numSamples, const ResonatorBank& bank) noexcept
+    {
+        constexpr int laneWidth = ModalSineKernel::laneWidth;
+
+        auto* real = bank.real;
+        auto* imag = bank.imag;
+        auto* modeOutputs = bank.modeOutputs;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto x = input != nullptr ? input[i] : 0.0f;
+
+            for (int j = 0; j < bank.numResonators; ++j)
+            {
+                auto newReal = bank.poleReal[j] * real[j] - bank.poleImag[j] * imag[j] + bank.inputGains[j] * x;
+                auto newImag = bank.poleImag[j] * real[j] + bank.poleReal[j] * imag[j];
+                real[j] = newReal;
+                imag[j] = newImag;
+                modeOutputs[j] = newImag;
+            }
+
+            for (int pickup = 0; pickup < bank.numPickups; ++pickup)
+            {
+                auto* weights = bank.outputWeights[pickup];
+                float sums[laneWidth] = {};
+
+                for (int group = 0; group < bank.numResonators; group += laneWidth)
+                    for (int lane = 0; lane < laneWidth; ++lane)
+                        sums[lane] += modeOutputs[group + lane] * weights[group + lane];
+
+                float sum = 0;
+
+                for (auto laneSum : sums)
+                    sum += laneSum;
+
+                outputs[pickup][i] = sum * bank.gain;
+            }
+        }
+    }
+
+    //==============================================================================
+    template <typename FloatType, bool compensated, ModalSineKernel::Accuracy accuracy>
+    void renderGeneric (float* const* outputs, int numSamples, const ModeBank<FloatType>& bank) noexcept
+    {
+        renderModeBlock<FloatType, compensated, accuracy> (outputs, numSamples, bank);
+    }
+
+    inline void renderResonatorsGeneric (const float* input, float* const* outputs, int numSamples, const ResonatorBank& bank) noexcept
+    {
+        renderResonatorBlock (input, outputs, numSamples, bank);
+    }
+
+   #if MODAL_KERNEL_DISPATCH
+    template <typename FloatType, bool compensated, ModalSineKernel::Accuracy accuracy>
+    __attribute__ ((target ("avx2,fma")))
+    void renderAVX2 (float* const* outputs, int numSamples, const ModeBank<FloatType>& bank) noexcept
+    {
+        renderModeBlock<FloatType, compensated, accuracy> (outputs, numSamples, bank);
+    }
+
+    template <typename FloatType, bool compensated, ModalSineKernel::Accuracy accuracy>
+    __attribute__ ((target ("avx512f,avx2,fma")))
+    void renderAVX512 (float* const* outputs, int numSamples, const ModeBank<FloatType>& bank) noexcept
+    {
+        renderModeBlock<FloatType, compensated, accuracy> (outputs, numSamples, bank);
+    }
+
+    __attribute__ ((target ("avx2,fma")))
+    inline void renderResonatorsAVX2 (const float* input, float* const* outputs, int numSamples, const ResonatorBank& bank) noexcept
+    {
+        renderResonatorBlock (input, outputs, numSamples, bank);
+    }
+
+    __attribute__ ((target ("avx512f,avx2,fma")))
+    inline void renderResonatorsAVX512 (const float* input, float* const* outputs, int numSamples, const ResonatorBank& bank) noexcept
+    {
+        renderResonatorBlock (input, outputs, numSamples, bank);
+    }
+   #endif
+
+    /** Renders a block with the given variant, which must be one that
+        detectVariant() allows on this machine.
+    */
+    template <typename FloatType, bool compensated, ModalSineKernel::Accuracy accuracy>
+    void render (Variant variant, float* const* outputs, int numSamples, const ModeBank<FloatType>& bank) noexcept
+    {
+       #if MODAL_KERNEL_DISPATCH
+        switch (variant)
+        {
+            case Variant::avx512:   return renderAVX512<FloatType, compensated, accuracy> (outputs, numSamples, bank);
+            case Variant::avx2:     return renderAVX2<FloatType, compensated, accuracy> (outputs, numSamples, bank);
+            case Variant::generic:  break;
+        }
+       #else
+        ignoreUnused (variant);
+       #endif
+
+        renderGeneric<FloatType, compensated, accuracy> (outputs, numSamples, bank);
+    }
+
+    /** Runs a resonator bank with the given variant. */
+    inline void render (Variant variant, const float* input, float* const* outputs, int numSamples, const ResonatorBank& bank) noexcept
+    {
+       #if MODAL_KERNEL_DISPATCH
+        switch (variant)
+        {
+            case Variant::avx512:   return renderResonatorsAVX512 (input, outputs, numSamples, bank);
+            case Variant::avx2:     return renderResonatorsAVX2 (input, outputs, numSamples, bank);
+            case Variant::generic:  break;
+        }
+       #else
+        ignoreUnused (variant);
+       #endif
+
+        renderResonatorsGeneric (input, outputs, numSamples, bank);
+    }
+}
@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    A bank of damped resonators tuned like the string's modes, for exciting
+    the modal model with an external signal instead of a pluck.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalRenderKernels.h"
+
+//==============================================================================
+/** Owns the state and coefficients of a set of two-pole resonators, laid out
+    so that ModalRenderKernels can process them all together.
+
+    All the memory is allocated in the constructor. Retuning only rewrites the
+    coefficients and leaves the filter states alone, so it can be done from
+    the audio thread at any time, and a resonator that's already ringing just
+    carries on at its new frequency.
+*/
+class ModalResonatorBank
+{
+public:
+    explicit ModalResonatorBank (int maxResonators)
+        : capacity (ModalSineKernel::roundUpToLanes (jmax (1, maxResonators))),
+          storage ((size_t) capacity * numArrays, 0.0f)
+    {
+    }
+
+    int getCapacity() const noexcept                { return capacity; }
+    int getNumResonators() const noexcept           { return numResonators; }
+    size_t getReservedBytes() const noexcept        { return storage.capacity() * sizeof (float); }
+    void prefault() const noexcept                  { ModalRealtimeProfile::prefault (storage); }
+
+    /** Sets how many of the resonators are processed. They're processed in
+        whole groups, so the rest of the last group is muted.
+    */
+    void setNumResonators (int newNumResonators) noexcept
+    {
+        numResonators = jlimit (0, capacity, newNumResonators);
+
+        for (int i = numResonators; i < ModalSineKernel::roundUpToLanes (numResonators); ++i)
+            mute (i);
+    }
+
+    /** Sets one resonator's frequency, and how much its amplitude is multiplied
+        by on each sample. Its gain is set so that a sine at the resonant
+        frequency comes out at the same level as it went in.
+    */
+    void tune (int index, double frequency, double decayMultiplier, double sampleRate) noexcept
+    {
+        jassert (isPositiveAndBelow (index, capacity));
+
+        auto radius = jlimit (0.0, 0.9999999, decayMultiplier);
+        auto angle = MathConstants<double>::twoPi * jlimit (0.0, sampleRate * 0.5, frequency) / sampleRate;
+
+        array (poleRealArray)[index] = (float) (radius * std::cos (angle));
+        array (poleImagArray)[index] = (float) (radius * std::sin (angle));
+        array (inputGainArray)[index] = (float) (2.0 * (1.0 - radius));
+    }
+
+    /** Silences a resonator, so that it adds nothing to the output. */
+    void mute (int index) noexcept
+    {
+        array (poleRealArray)[index] = array (poleImagArray)[index] = array (inputGainArray)[index] = 0.0f;
+        array (realArray)[index] = array (imagArray)[index] = 0.0f;
+    }
+
+    /** Stops all the resonators ringing. */
+    void reset() noexcept
+    {
+        FloatVectorOperations::clear (array (realArray), capacity);
+        FloatVectorOperations::clear (array (imagArray), capacity);
+    }
+
+    /** Runs a block of input through the bank, writing each output as the
+        sum of the resonators multiplied by that output's weights. The weight
+        arrays must have room for getCapacity() values.
+    */
+    void process (ModalRenderKernels::Variant variant, const float* input, float* const* outputs,
+                  const float* const* outputWeights, int numOutputs, int numSamples, float gain) noexcept
+    {
+        jassert (numOutputs <= ModalRenderKernels::maxOutputs);
+
+        ModalRenderKernels::ResonatorBank bank { array (realArray), array (imagArray),
+                                                 array (poleRealArray), array (poleImagArray), array (inputGainArray),
+                                                 {}, array (modeOutputArray),
+                                                 ModalSineKernel::roundUpToLanes (numResonators), numOutputs, gain };
+
+        for (int i = 0; i < numOutputs; ++i)
+            bank.outputWeights[i] = outputWeights[i];
+
+        ModalRenderKernels::render (variant, input, outputs, numSamples, bank);
+    }
+
+    /** Returns the sum of the resonators' amplitudes, which is an upper bound
+        on how loud the bank could be if nothing else were fed in.
+    */
+    float getTotalAmplitude() const noexcept
+    {
+        float total = 0.0f;
+
+        for (int i = 0; i < numResonators; ++i)
+            total += std::hypot (array (realArray)[i], array (imagArray)[i]);
+
+        return total;
+    }
+
+private:
+    enum ArrayIndex { realArray, imagArray, poleRealArray, poleImagArray, inputGainArray, modeOutputArray, numArrays };
+
+    float* array (ArrayIndex index) noexcept                { return storage.data() + (size_t) index * (size_t) capacity; }
+    const float* array (ArrayIndex index) const noexcept    { return storage.data() + (size_t) index * (size_t) capacity; }
+
+    int capacity, numResonators = 0;
+    std::vector<float> storage;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalResonatorBank)
+};
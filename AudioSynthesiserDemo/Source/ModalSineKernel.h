@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    Polynomial sine oscillators for the modal voice, written so that the
+    compiler can vectorise them across a whole bank of modes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Sine oscillators built from a phase accumulator and a minimax polynomial.
+
+    Unlike a table lookup, every step here is plain arithmetic with no
+    data-dependent memory access, so a loop over a group of oscillators turns
+    into a handful of SIMD instructions.
+
+    Phases are unsigned 32-bit fractions of a cycle, which wrap around for
+    free and have the same resolution at every frequency. Before evaluating
+    the polynomial, the phase is folded into the quarter cycle either side of
+    zero, where sine is odd, so only odd powers are needed.
+*/
+namespace ModalSineKernel
+{
+    using Phase = uint32;
+
+    /** The worst-case error of each tier, relative to a full-scale sine. */
+    enum class Accuracy
+    {
+        fast,       // about -83 dB, 3 terms in float
+        standard,   // about -122 dB, 4 terms in float
+        precise     // about -149 dB, 5 terms in double, limited by the float output
+    };
+
+    /** Oscillators are processed in groups of this many, which fills an AVX
+        register with floats. Banks should be padded to a multiple of it.
+    */
+    static constexpr int laneWidth = 8;
+
+    constexpr int roundUpToLanes (int num) noexcept     { return (num + laneWidth - 1) / laneWidth * laneWidth; }
+
+    /** Converts a number of cycles to a phase, discarding the whole cycles. */
+    inline Phase phaseFromCycles (double cycles) noexcept
+    {
+        return (Phase) (uint64) ((cycles - std::floor (cycles)) * 4294967296.0);
+    }
+
+    inline Phase phaseIncrement (double frequency, double sampleRate) noexcept
+    {
+        return phaseFromCycles (frequency / sampleRate);
+    }
+
+    //==============================================================================
+    /** Returns the sine of a phase. This has no branches, so it can be inlined
+        into a loop that the compiler vectorises.
+    */
+    template <Accuracy accuracy>
+    inline float sine (Phase phase) noexcept
+    {
+        constexpr int32 quarterCycle = 1 << 30;
+
+        // sin (pi - x) == sin (x), and in the same way on the negative side
+        auto p = (int32) phase;
+        auto folded = (p > quarterCycle || p < -quarterCycle) ? (int32) (0x80000000u - (uint32) p) : p;
+
+        if constexpr (accuracy == Accuracy::fast)
+        {
+            auto x = (float) folded * (1.0f / 4294967296.0f);
+            auto x2 = x * x;
+            return x * (6.28128008f + x2 * (-41.0952427f + x2 * 73.5855147f));
+        }
+        else if constexpr (accuracy == Accuracy::standard)
+        {
+            auto x = (float) folded * (1.0f / 4294967296.0f);
+            auto x2 = x * x;
+            return x * (6.28316404f + x2 * (-41.3371424f + x2 * (81.3407689f + x2 * -70.9934333f)));
+        }
+        else
+        {
+            auto x = (double) folded * (1.0 / 4294967296.0);
+            auto x2 = x * x;
+            return (float) (x * (6.28318516008947755 + x2 * (-41.3416550314163046 + x2 * (81.6010040732634811
+                                                            + x2 * (-76.5497822936347782 + x2 * 39.5367060660182837)))));
+        }
+    }
+
+    //==============================================================================
+    /** Writes the current output of a bank of oscillators, and advances each of
+        them by one sample.
+    */
+    template <Accuracy accuracy>
+    inline void tick (float* output, Phase* phases, const Phase* increments, int numOscillators) noexcept
+    {
+        for (int i = 0; i < numOscillators; ++i)
+        {
+            output[i] = sine<accuracy> (phases[i]);
+            phases[i] += increments[i];
+        }
+    }
+}
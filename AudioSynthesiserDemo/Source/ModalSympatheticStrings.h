@@ -0,0 +1,297 @@
+/*
+  ==============================================================================
+
+    Lightly damped virtual strings that ring in sympathy with the notes
+    being played, coupled to them through a sparse matrix.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModeTable.h"
+#include "ModalResonatorBank.h"
+
+//==============================================================================
+/** A set of virtual strings, each of which is a small bank of resonators
+    tuned like the first few modes of one note, driven by the voices' output.
+    The strings aren't stopped by a damper, so they decay far more slowly
+    than a played note of the same pitch.
+
+    On a real instrument every string hears the bridge, but only the strings
+    with modes close to the played note's modes pick up any noticeable
+    energy. So rather than feeding every voice to every string, a string is
+    only coupled to a voice if some pair of their modes lie within a small
+    distance in pitch, with a weight that falls off as they get further apart.
+    These weights are kept as a compressed sparse row matrix, with a row for
+    each string and a column for each voice, so the per-sample cost grows with
+    the number of coupled pairs rather than with strings times voices.
+
+    Strings that aren't coupled to anything and have died away are skipped
+    altogether, so a large set of strings costs little while it's quiet.
+
+    Everything is allocated in the constructor. The rest is safe to call from
+    the audio thread.
+*/
+class ModalSympatheticStrings
+{
+public:
+    /** Each string is a single group of lanes in the render loop. */
+    static constexpr int modesPerString = ModalSineKernel::laneWidth;
+
+    ModalSympatheticStrings (int numStringsToUse, int lowestNoteToUse, int maxSourcesToUse, int maxBlockSize)
+        : numStrings (jlimit (1, ModeTable::numNotes, numStringsToUse)),
+          lowestNote (jlimit (0, ModeTable::numNotes - numStrings, lowestNoteToUse)),
+          maxSources (jmax (1, maxSourcesToUse)),
+          blockSize (jmax (1, maxBlockSize)),
+          sourceNotes ((size_t) maxSources, -1),
+          rowStarts ((size_t) numStrings + 1, 0),
+          columns ((size_t) (numStrings * maxSources)),
+          weights ((size_t) (numStrings * maxSources)),
+          driveScratch ((size_t) blockSize),
+          stringScratch ((size_t) blockSize)
+    {
+        for (int i = 0; i < numStrings; ++i)
+            strings.add (new ModalResonatorBank (modesPerString));
+
+        // the strings are heard through a pickup near one end, where the higher modes are quieter
+        for (int i = 0; i < modesPerString; ++i)
+            outputWeights[i] = 1.0f / (float) (i + 1);
+    }
+
+    int getNumStrings() const noexcept          { return numStrings; }
+    int getMaxSources() const noexcept          { return maxSources; }
+    int getMaxBlockSize() const noexcept        { return blockSize; }
+
+    /** Returns how much memory the strings and their scratch buffers are holding on to. */
+    size_t getReservedBytes() const noexcept
+    {
+        size_t total = sizeof (*this);
+
+        for (auto* string : strings)
+            total += sizeof (*string) + string->getReservedBytes();
+
+        for (auto* ints : { &sourceNotes, &rowStarts, &columns })
+            total += ints->capacity() * sizeof (int);
+
+        for (auto* floats : { &weights, &driveScratch, &stringScratch })
+            total += floats->capacity() * sizeof (float);
+
+        return total;
+    }
+
+    /** Touches the strings and scratch buffers, so the audio thread doesn't fault on them. */
+    void prefault() const noexcept
+    {
+        for (auto* string : strings)
+        {
+            ModalRealtimeProfile::prefault (string, sizeof (*string));
+            string->prefault();
+        }
+
+        for (auto* ints : { &sourceNotes, &rowStarts, &columns })
+            ModalRealtimeProfile::prefault (*ints);
+
+        for (auto* floats : { &weights, &driveScratch, &stringScratch })
+            ModalRealtimeProfile::prefault (*floats);
+    }
+
+    /** Returns how many string-voice pairs are currently coupled. */
+    int getNumCoupledPairs() const noexcept     { return rowStarts[(size_t) numStrings]; }
+
+    /** Returns how many strings were processed in the last block. */
+    int getNumActiveStrings() const noexcept    { return numActiveStrings; }
+
+    /** Sets how strongly a string is driven by a voice whose modes line up
+        exactly with its own.
+    */
+    void setCouplingAmount (float newAmount) noexcept
+    {
+        if (newAmount != couplingAmount)
+        {
+            couplingAmount = newAmount;
+            couplingNeedsUpdate = true;
+        }
+    }
+
+    /** Sets the note that one of the sources is playing, or -1 if it's silent. */
+    void setSourceNote (int sourceIndex, int midiNoteNumber) noexcept
+    {
+        jassert (isPositiveAndBelow (sourceIndex, maxSources));
+
+        if (sourceNotes[(size_t) sourceIndex] != midiNoteNumber)
+        {
+            sourceNotes[(size_t) sourceIndex] = midiNoteNumber;
+            couplingNeedsUpdate = true;
+        }
+    }
+
+    /** Stops all the strings ringing. */
+    void reset() noexcept
+    {
+        for (auto* string : strings)
+            string->reset();
+    }
+
+    /** Runs a block of the sources' signals through the strings, and adds
+        what they play to the output. The table can change from block to block,
+        in which case the strings are retuned without being stopped.
+    */
+    void process (const ModeTable& table, ModalRenderKernels::Variant variant,
+                  const float* const* sourceSignals, float* output, int numSamples, float gain) noexcept
+    {
+        jassert (numSamples <= blockSize);
+
+        if (table.version != tunedVersion)
+        {
+            tune (table);
+            couplingNeedsUpdate = true;
+        }
+
+        if (couplingNeedsUpdate)
+            updateCoupling (table);
+
+        numActiveStrings = 0;
+        float* outputs[] = { stringScratch.data() };
+        const float* stringWeights[] = { outputWeights };
+
+        for (int s = 0; s < numStrings; ++s)
+        {
+            auto* string = strings.getUnchecked (s);
+            const float* drive = nullptr;
+
+            if (auto start = rowStarts[(size_t) s], end = rowStarts[(size_t) s + 1]; start < end)
+            {
+                auto* mix = driveScratch.data();
+                FloatVectorOperations::copyWithMultiply (mix, sourceSignals[columns[(size_t) start]], weights[(size_t) start], numSamples);
+
+                for (auto k = start + 1; k < end; ++k)
+                    FloatVectorOperations::addWithMultiply (mix, sourceSignals[columns[(size_t) k]], weights[(size_t) k], numSamples);
+
+                drive = mix;
+            }
+            else if (string->getTotalAmplitude() < silenceLevel)
+            {
+                continue;
+            }
+
+            string->process (variant, drive, outputs, stringWeights, 1, numSamples, gain);
+            FloatVectorOperations::add (output, stringScratch.data(), numSamples);
+            ++numActiveStrings;
+        }
+    }
+
+private:
+    void tune (const ModeTable& table) noexcept
+    {
+        for (int s = 0; s < numStrings; ++s)
+        {
+            auto note = lowestNote + s;
+            auto* string = strings.getUnchecked (s);
+
+            for (int i = 0; i < modesPerString; ++i)
+            {
+                auto frequency = table.noteFrequencies[note] * table.frequencyRatios[i];
+
+                // a mode up near Nyquist would alias, so it's left out
+                if (frequency < table.sampleRate * 0.45)
+                    string->tune (i, frequency, std::pow (table.decayMultipliers[note][i], dampingScale), table.sampleRate);
+                else
+                    string->mute (i);
+            }
+
+            string->setNumResonators (modesPerString);
+        }
+
+        tunedVersion = table.version;
+    }
+
+    /** Works out how strongly each string hears each of the notes being
+        played, and keeps only the pairs that hear each other at all.
+    */
+    void updateCoupling (const ModeTable& table) noexcept
+    {
+        int numPairs = 0;
+
+        for (int s = 0; s < numStrings; ++s)
+        {
+            rowStarts[(size_t) s] = numPairs;
+
+            for (int source = 0; source < maxSources; ++source)
+            {
+                auto note = sourceNotes[(size_t) source];
+
+                if (! isPositiveAndBelow (note, ModeTable::numNotes))
+                    continue;
+
+                auto weight = getCouplingWeight (table, lowestNote + s, note);
+
+                if (weight > 0.0f)
+                {
+                    columns[(size_t) numPairs] = source;
+                    weights[(size_t) numPairs] = weight * couplingAmount;
+                    ++numPairs;
+                }
+            }
+        }
+
+        rowStarts[(size_t) numStrings] = numPairs;
+        couplingNeedsUpdate = false;
+    }
+
+    /** Adds up how close each of a string's modes is to the nearest of a
+        note's modes. Both lists of frequencies are in ascending order, so they
+        can be walked through together.
+    */
+    static float getCouplingWeight (const ModeTable& table, int stringNote, int sourceNote) noexcept
+    {
+        auto stringFundamental = table.noteFrequencies[stringNote];
+        auto sourceFundamental = table.noteFrequencies[sourceNote];
+        float weight = 0.0f;
+        int sourceMode = 0;
+
+        for (int i = 0; i < modesPerString; ++i)
+        {
+            auto frequency = stringFundamental * table.frequencyRatios[i];
+
+            while (sourceMode < ModeTable::numModes - 1
+                    && sourceFundamental * table.frequencyRatios[sourceMode + 1] <= frequency)
+                ++sourceMode;
+
+            for (int j = sourceMode; j <= jmin (sourceMode + 1, ModeTable::numModes - 1); ++j)
+            {
+                auto cents = std::abs (1200.0f * std::log2 (sourceFundamental * table.frequencyRatios[j] / frequency));
+                weight += jmax (0.0f, 1.0f - cents / couplingWidthCents);
+            }
+        }
+
+        return weight;
+    }
+
+    // how much of a played note's damping the strings have; a tenth makes them ring ten times as long
+    static constexpr double dampingScale = 0.1;
+
+    // how far apart in pitch two modes can be and still be coupled
+    static constexpr float couplingWidthCents = 30.0f;
+
+    // a string whose modes add up to less than this, with nothing driving it, isn't processed
+    static constexpr float silenceLevel = 1.0e-5f;
+
+    const int numStrings, lowestNote, maxSources, blockSize;
+    OwnedArray<ModalResonatorBank> strings;
+    float outputWeights[modesPerString];
+    uint64 tunedVersion = 0;
+
+    std::vector<int> sourceNotes;
+    float couplingAmount = 0.05f;
+    bool couplingNeedsUpdate = true;
+
+    // the coupling matrix, in compressed sparse row form
+    std::vector<int> rowStarts, columns;
+    std::vector<float> weights;
+
+    std::vector<float> driveScratch, stringScratch;
+    int numActiveStrings = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalSympatheticStrings)
+};
@@ -0,0 +1,17 @@
+/*
+  ==============================================================================
+
+    The entry point for the plugin build of the modal synth, which is made
+    from AudioSynthesiserPlugin.jucer.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "ModalSynthProcessor.h"
+
+//==============================================================================
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new ModalSynthProcessor();
+}
@@ -0,0 +1,372 @@
+/*
+  ==============================================================================
+
+    The modal synth wrapped up as an AudioProcessor, so that it can be built
+    as a plugin, with its settings as host-automatable parameters.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AudioSynthesiserDemo.h"
+
+//==============================================================================
+/** Runs a SynthAudioSource inside a plugin host.
+
+    The settings live in an AudioProcessorValueTreeState. The ones that the
+    voices pick up straight away are read from the parameters' atomics once
+    at the start of each block. The ones that make up the preset need a new
+    mode table, which is built off the audio thread, so those are watched by
+    a timer on the message thread instead, and the table is published when
+    they change.
+
+    The factory presets are the plugin's programs. The decay settings that
+    aren't parameters come from the program, so it's saved with the state.
+    Hosts can change the program or the state from any thread, but the preset
+    can only be loaded on the message thread, so the timer does that too.
+*/
+class ModalSynthProcessor final : public AudioProcessor,
+                                  private Timer
+{
+public:
+    ModalSynthProcessor()
+        : AudioProcessor (BusesProperties().withInput  ("Excitation", AudioChannelSet::stereo(), false)
+                                           .withOutput ("Output",     AudioChannelSet::stereo(), true))
+    {
+        for (int i = 0; i < numPresetParameters; ++i)
+            presetValues[i] = parameters.getRawParameterValue (presetParameterIDs[i]);
+
+        stereoWidth     = parameters.getRawParameterValue ("stereoWidth");
+        sympathetic     = parameters.getRawParameterValue ("sympathetic");
+        excitation      = parameters.getRawParameterValue ("excitation");
+        stereoPickups   = parameters.getRawParameterValue ("stereoPickups");
+        mpe             = parameters.getRawParameterValue ("mpe");
+
+        applyPresetParameters();
+        startTimerHz (30);
+    }
+
+    ~ModalSynthProcessor() override
+    {
+        stopTimer();
+    }
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        synthSource.prepareToPlay (samplesPerBlock, sampleRate);
+
+        // every block is rendered straight from its own MIDI, with no lookahead
+        setLatencySamples (0);
+    }
+
+    void releaseResources() override
+    {
+        synthSource.releaseResources();
+    }
+
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override
+    {
+        // the voices pan themselves across as many output channels as there are,
+        // and the excitation input is mixed down to mono
+        return ! layouts.getMainOutputChannelSet().isDisabled();
+    }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages) override
+    {
+        // the input is only read when it's the excitation, but without an input bus
+        // these channels hold whatever the host left in them
+        for (auto i = getTotalNumInputChannels(); i < buffer.getNumChannels(); ++i)
+            buffer.clear (i, 0, buffer.getNumSamples());
+
+        synthSource.stereoWidth         = stereoWidth->load();
+        synthSource.sympatheticLevel    = sympathetic->load();
+        synthSource.excitation          = (SineWaveVoice::Excitation) roundToInt (excitation->load());
+        synthSource.numPickups          = stereoPickups->load() >= 0.5f ? 2 : 1;
+        synthSource.mpeEnabled          = mpe->load() >= 0.5f;
+
+        synthSource.renderNextBlock (AudioSourceChannelInfo (buffer), midiMessages);
+
+        // the notes have been played, and nothing is passed on
+        midiMessages.clear();
+    }
+
+    using AudioProcessor::processBlock;
+
+    //==============================================================================
+    AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override                             { return true; }
+
+    const String getName() const override                       { return "Modal Synth"; }
+    bool acceptsMidi() const override                           { return true; }
+    bool producesMidi() const override                          { return false; }
+    double getTailLengthSeconds() const override                { return synthSource.tailLengthSeconds.load(); }
+
+    //==============================================================================
+    int getNumPrograms() override                               { return (int) ModalPreset::getFactoryPresets().size(); }
+    int getCurrentProgram() override                            { return currentProgram; }
+
+    const String getProgramName (int index) override
+    {
+        auto& presets = ModalPreset::getFactoryPresets();
+        return isPositiveAndBelow (index, (int) presets.size()) ? presets[(size_t) index].name : String();
+    }
+
+    void changeProgramName (int, const String&) override        {}
+
+    /** Loads a factory preset, and moves the parameters to its settings. */
+    void setCurrentProgram (int index) override
+    {
+        auto& presets = ModalPreset::getFactoryPresets();
+
+        if (! isPositiveAndBelow (index, (int) presets.size()))
+            return;
+
+        requestProgram (index);
+
+        auto& preset = presets[(size_t) index];
+        const float values[] = { preset.stiffness, preset.pluckPos, preset.pickupPositions[0], preset.pickupPositions[1] };
+
+        for (int i = 0; i < numPresetParameters; ++i)
+        {
+            auto* parameter = parameters.getParameter (presetParameterIDs[i]);
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (values[i]));
+        }
+
+        applyPendingProgram();
+    }
+
+    //==============================================================================
+    void getStateInformation (MemoryBlock& destData) override
+    {
+        auto state = parameters.copyState();
+        state.setProperty ("program", currentProgram.load(), nullptr);
+
+        if (auto xml = state.createXml())
+            copyXmlToBinary (*xml, destData);
+    }
+
+    /** Loads the program that the state was saved with, and then sets the
+        parameters, so that any that were changed afterwards are kept.
+    */
+    void setStateInformation (const void* data, int sizeInBytes) override
+    {
+        if (auto xml = getXmlFromBinary (data, sizeInBytes))
+        {
+            if (xml->hasTagName (parameters.state.getType()))
+            {
+                auto state = ValueTree::fromXml (*xml);
+                requestProgram ((int) state.getProperty ("program", 0));
+                parameters.replaceState (state);
+                applyPendingProgram();
+            }
+        }
+    }
+
+    //==============================================================================
+    static AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
+    {
+        ModalPreset defaults;
+        NormalisableRange<float> stringPosition { 0.01f, MathConstants<float>::pi - 0.01f };
+        AudioProcessorValueTreeState::ParameterLayout layout;
+
+        layout.add (std::make_unique<AudioParameterFloat> (ParameterID { "stiffness", 1 }, "Stiffness",
+                                                           NormalisableRange<float> { 0.0f, 2.0f }, defaults.stiffness));
+        layout.add (std::make_unique<AudioParameterFloat> (ParameterID { "pluckPos", 1 }, "Pluck position",
+                                                           stringPosition, defaults.pluckPos));
+        layout.add (std::make_unique<AudioParameterFloat> (ParameterID { "pickupPos", 1 }, "Pickup position",
+                                                           stringPosition, defaults.pickupPositions[0]));
+        layout.add (std::make_unique<AudioParameterFloat> (ParameterID { "secondPickupPos", 1 }, "Second pickup position",
+                                                           stringPosition, defaults.pickupPositions[1]));
+        layout.add (std::make_unique<AudioParameterFloat> (ParameterID { "stereoWidth", 1 }, "Stereo width",
+                                                           NormalisableRange<float> { 0.0f, 1.0f }, 0.0f));
+        layout.add (std::make_unique<AudioParameterFloat> (ParameterID { "sympathetic", 1 }, "Sympathetic strings",
+                                                           NormalisableRange<float> { 0.0f, 1.0f }, 0.0f));
+        layout.add (std::make_unique<AudioParameterChoice> (ParameterID { "excitation", 1 }, "Excitation",
+                                                            StringArray { "Pluck", "Audio input", "Bowed" }, 0));
+        layout.add (std::make_unique<AudioParameterBool> (ParameterID { "stereoPickups", 1 }, "Stereo pickups", false));
+        layout.add (std::make_unique<AudioParameterBool> (ParameterID { "mpe", 1 }, "MPE", true));
+
+        return layout;
+    }
+
+    ModalKeyboardState keyboardState;
+    SynthAudioSource synthSource { keyboardState };
+    AudioProcessorValueTreeState parameters { *this, nullptr, "ModalSynth", createParameterLayout() };
+
+private:
+    void timerCallback() override
+    {
+        applyPendingProgram();
+        synthSource.modeTables.collectGarbage();
+    }
+
+    /** Asks for a factory preset to be loaded on the message thread. If the
+        index isn't one of them, the current preset is kept.
+    */
+    void requestProgram (int index)
+    {
+        if (isPositiveAndBelow (index, getNumPrograms()))
+        {
+            currentProgram = index;
+            pendingProgram = index;
+        }
+    }
+
+    /** Loads any program that's been asked for, and then passes on the
+        parameters. Off the message thread, this is left for the timer.
+    */
+    void applyPendingProgram()
+    {
+        if (! MessageManager::existsAndIsCurrentThread())
+            return;
+
+        auto index = pendingProgram.exchange (-1);
+
+        if (index >= 0)
+            loadFactoryPreset (index);
+
+        applyPresetParameters();
+    }
+
+    /** Passes on any of the preset's parameters that have changed since they
+        were last looked at, which rebuilds the mode table. This must be called
+        on the message thread.
+    */
+    void applyPresetParameters()
+    {
+        for (int i = 0; i < numPresetParameters; ++i)
+        {
+            auto value = presetValues[i]->load();
+
+            if (value != appliedPresetValues[i])
+            {
+                appliedPresetValues[i] = value;
+                synthSource.setParameter (presetParameterIDs[i], value);
+            }
+        }
+    }
+
+    void loadFactoryPreset (int index)
+    {
+        synthSource.loadPreset (ModalPreset::getFactoryPresets()[(size_t) index]);
+
+        // the parameters are applied on top of the program, even if they haven't changed
+        std::fill (std::begin (appliedPresetValues), std::end (appliedPresetValues), std::numeric_limits<float>::quiet_NaN());
+    }
+
+    // the parameters that go into the mode table, with the same IDs as SynthAudioSource::setParameter() uses
+    static constexpr int numPresetParameters = 4;
+    static constexpr const char* presetParameterIDs[numPresetParameters] = { "stiffness", "pluckPos", "pickupPos", "secondPickupPos" };
+    std::atomic<float>* presetValues[numPresetParameters] = {};
+    float appliedPresetValues[numPresetParameters] = { std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::quiet_NaN(),
+                                                       std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::quiet_NaN() };
+
+    // the parameters that are read at the start of every block
+    std::atomic<float>* stereoWidth = nullptr;
+    std::atomic<float>* sympathetic = nullptr;
+    std::atomic<float>* excitation = nullptr;
+    std::atomic<float>* stereoPickups = nullptr;
+    std::atomic<float>* mpe = nullptr;
+
+    std::atomic<int> currentProgram { 0 }, pendingProgram { -1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalSynthProcessor)
+};
+
+//==============================================================================
+/** The plugin's editor: a knob for each of the continuous parameters, the
+    switches, and a keyboard for playing it without a MIDI controller.
+*/
+class ModalSynthEditor final : public AudioProcessorEditor
+{
+public:
+    explicit ModalSynthEditor (ModalSynthProcessor& p)
+        : AudioProcessorEditor (p),
+          keyboardComponent (p.keyboardState.getDisplayState(), MidiKeyboardComponent::horizontalKeyboard)
+    {
+        auto& parameters = p.parameters;
+
+        for (auto* slider : getSliders())
+        {
+            addAndMakeVisible (*slider);
+            sliderAttachments.add (new SliderAttachment (parameters, slider->getComponentID(), slider->slider));
+        }
+
+        for (auto* button : { &stereoPickupsButton, &mpeButton })
+            addAndMakeVisible (*button);
+
+        stereoPickupsAttachment = std::make_unique<ButtonAttachment> (parameters, "stereoPickups", stereoPickupsButton);
+        mpeAttachment = std::make_unique<ButtonAttachment> (parameters, "mpe", mpeButton);
+
+        addAndMakeVisible (excitationBox);
+        excitationBox.addItemList (parameters.getParameter ("excitation")->getAllValueStrings(), 1);
+        excitationAttachment = std::make_unique<ComboBoxAttachment> (parameters, "excitation", excitationBox);
+
+        addAndMakeVisible (keyboardComponent);
+        setSize (640, 300);
+    }
+
+    void paint (Graphics& g) override
+    {
+        g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
+    }
+
+    void resized() override
+    {
+        auto bounds = getLocalBounds().reduced (8);
+        keyboardComponent.setBounds (bounds.removeFromTop (64));
+        bounds.removeFromTop (8);
+
+        auto controls = bounds.removeFromTop (24);
+        stereoPickupsButton.setBounds (controls.removeFromLeft (150));
+        mpeButton.setBounds (controls.removeFromLeft (100));
+        excitationBox.setBounds (controls.removeFromLeft (200));
+        bounds.removeFromTop (8);
+
+        auto sliders = getSliders();
+        auto sliderWidth = bounds.getWidth() / (int) sliders.size();
+
+        for (auto* slider : sliders)
+            slider->setBounds (bounds.removeFromLeft (sliderWidth).reduced (2));
+    }
+
+private:
+    std::vector<LabeledSlider*> getSliders()
+    {
+        return { &stiffness, &pluckPos, &pickupPos, &secondPickupPos, &stereoWidth, &sympathetic };
+    }
+
+    /** A LabeledSlider whose component ID is the ID of its parameter. */
+    struct ParameterSlider : public LabeledSlider
+    {
+        ParameterSlider (const String& name, const String& parameterID)  : LabeledSlider (name)
+        {
+            setComponentID (parameterID);
+        }
+    };
+
+    ParameterSlider stiffness       { "Stiffness",      "stiffness" };
+    ParameterSlider pluckPos        { "Pluck pos",      "pluckPos" };
+    ParameterSlider pickupPos       { "Pickup pos",     "pickupPos" };
+    ParameterSlider secondPickupPos { "Second pickup",  "secondPickupPos" };
+    ParameterSlider stereoWidth     { "Stereo width",   "stereoWidth" };
+    ParameterSlider sympathetic     { "Sympathetic",    "sympathetic" };
+    OwnedArray<SliderAttachment> sliderAttachments;
+
+    ToggleButton stereoPickupsButton { "Stereo pickups" };
+    ToggleButton mpeButton { "MPE" };
+    ComboBox excitationBox;
+    std::unique_ptr<ButtonAttachment> stereoPickupsAttachment, mpeAttachment;
+    std::unique_ptr<ComboBoxAttachment> excitationAttachment;
+
+    MidiKeyboardComponent keyboardComponent;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModalSynthEditor)
+};
+
+inline AudioProcessorEditor* ModalSynthProcessor::createEditor()
+{
+    return new ModalSynthEditor (*this);
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    The frequencies and decay rates of the string's modes, worked out once
+    for every MIDI note and shared by all the voices.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalPreset.h"
+
+//==============================================================================
+/** An immutable table of mode frequencies and decay rates for one stiffness
+    setting and sample rate.
+
+    The ratio of each mode's frequency to the note's fundamental only depends
+    on the stiffness, so it's stored once. The per-sample decay multiplier
+    also depends on the mode's absolute frequency, so that's stored for all
+    128 notes. Starting a note then only needs one multiply per mode.
+
+    The table also holds the pluck and pickup shapes of the preset it was
+    built from, so a whole patch can be swapped in one go.
+*/
+struct ModeTable
+{
+    static constexpr int numModes = ModalPreset::numModes;
+    static constexpr int numNotes = 128;
+    static constexpr int maxPickups = ModalPreset::maxPickups;
+
+    /** Builds a table from a preset's modes, which may have come from
+        somewhere other than the preset's own settings.
+    */
+    ModeTable (const ModalPreset& presetToUse, const ModalPresetModes& modes, double sampleRateToUse)
+        : preset (presetToUse), sampleRate (sampleRateToUse), modesHash (modes.getHash())
+    {
+        for (int i = 0; i < numModes; i++)
+        {
+            frequencyRatios[i] = modes.frequencyRatios[i];
+            dampings[i] = modes.dampings[i];
+            pluckAmplitudes[i] = modes.amplitudes[i];
+
+            for (int pickup = 0; pickup < maxPickups; ++pickup)
+                pickupWeights[pickup][i] = modes.pickupWeights[pickup][i];
+        }
+
+        for (int note = 0; note < numNotes; ++note)
+        {
+            noteFrequencies[note] = (float) MidiMessage::getMidiNoteInHertz (note);
+
+            for (int i = 0; i < numModes; i++)
+                decayMultipliers[note][i] = exp (-dampings[i] * noteFrequencies[note] * frequencyRatios[i] / sampleRate);
+        }
+    }
+
+    ModeTable (const ModalPreset& presetToUse, double sampleRateToUse)
+        : ModeTable (presetToUse, ModalPresetModes (presetToUse), sampleRateToUse)
+    {
+    }
+
+    ModeTable (float stiffnessToUse, double sampleRateToUse)
+        : ModeTable (ModalPreset { "", stiffnessToUse }, sampleRateToUse)
+    {
+    }
+
+    /** Returns the modes that this table was built from. */
+    ModalPresetModes getModes() const noexcept
+    {
+        ModalPresetModes modes;
+
+        for (int i = 0; i < numModes; i++)
+        {
+            modes.frequencyRatios[i] = frequencyRatios[i];
+            modes.dampings[i] = dampings[i];
+            modes.amplitudes[i] = (float) pluckAmplitudes[i];
+
+            for (int pickup = 0; pickup < maxPickups; ++pickup)
+                modes.pickupWeights[pickup][i] = pickupWeights[pickup][i];
+        }
+
+        return modes;
+    }
+
+    const ModalPreset preset;
+    double sampleRate;
+
+    // every table gets a new number, so that a voice can tell when it's been
+    // replaced without holding on to the old one
+    const uint64 version = ++numTablesCreated;
+
+    // tells apart tables whose modes differ, even if their presets' settings are the same
+    const uint64 modesHash;
+
+    float frequencyRatios[numModes];                // each mode's frequency relative to the fundamental
+    float dampings[numModes];                       // each mode's decay rate, relative to its frequency
+    float noteFrequencies[numNotes];                // the fundamental of each MIDI note, in Hz
+    double decayMultipliers[numNotes][numModes];    // per-sample amplitude multiplier of each mode of each note
+    double pluckAmplitudes[numModes];               // each mode's starting amplitude, for the preset's pluck position
+    float pickupWeights[maxPickups][numModes];      // how much each pickup hears each mode
+
+private:
+    static inline std::atomic<uint64> numTablesCreated { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModeTable)
+};
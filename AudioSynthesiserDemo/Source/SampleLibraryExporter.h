@@ -0,0 +1,225 @@
+/*
+  ==============================================================================
+
+    Batch-renders a grid of modal notes to audio files, for building
+    multisampled instruments from the synth.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ModalOfflineRenderer.h"
+
+//==============================================================================
+/** Renders every combination of note, velocity and string parameters to its
+    own file, spreading the renders across a thread pool.
+
+    Completed files are appended to a manifest in the output folder as soon as
+    they're finished, so an interrupted export can be restarted and will only
+    render whatever is still missing. The files are named after everything
+    that changes what's in them, including where in the note they start, so
+    an export into the same folder with other settings doesn't skip anything.
+*/
+class SampleLibraryExporter
+{
+public:
+    struct Options
+    {
+        File outputFolder;
+        Array<int> notes;
+        Array<float> velocities      { 1.0f };
+        Array<float> stiffnesses     { 0.0f };
+        Array<float> pluckPositions  { 0.2f };
+        Array<float> pickupPositions { 0.3f };
+
+        double sampleRate = 48000.0;
+        int numChannels = 1;
+        int bitsPerSample = 24;
+        bool useFlac = false;
+        int numThreads = SystemStats::getNumCpus();
+
+        float silenceThresholdDb = -90.0f;
+        double maxSecondsPerNote = 30.0;
+        double startSeconds = 0.0;
+    };
+
+    explicit SampleLibraryExporter (const Options& optionsToUse)
+        : options (optionsToUse)
+    {
+        for (auto note : options.notes)
+            for (auto velocity : options.velocities)
+                for (auto stiffness : options.stiffnesses)
+                    for (auto pluck : options.pluckPositions)
+                        for (auto pickup : options.pickupPositions)
+                            allNotes.push_back ({ note, velocity, stiffness, pluck, pickup });
+    }
+
+    /** Renders everything that isn't already listed in the manifest, and
+        returns the number of renders that failed.
+    */
+    int run()
+    {
+        if (! options.outputFolder.createDirectory())
+            ConsoleApplication::fail ("Couldn't create " + options.outputFolder.getFullPathName());
+
+        auto alreadyDone = loadManifest();
+        int numSkipped = 0;
+
+        ThreadPool pool (jmax (1, options.numThreads));
+
+        for (auto& note : allNotes)
+        {
+            if (alreadyDone.count (getFileNameFor (note)) > 0)
+                ++numSkipped;
+            else
+                pool.addJob (new RenderJob (*this, note), true);
+        }
+
+        auto numToRender = (int) allNotes.size() - numSkipped;
+        std::cout << "Rendering " << numToRender << " notes (" << numSkipped
+                  << " already in manifest) on " << pool.getNumThreads() << " threads" << std::endl;
+
+        for (int lastReported = -1; pool.getNumJobs() > 0;)
+        {
+            Thread::sleep (250);
+
+            auto numDone = numFinished.load();
+
+            if (numDone != lastReported)
+            {
+                std::cout << "\r" << numDone << " / " << numToRender << std::flush;
+                lastReported = numDone;
+            }
+        }
+
+        std::cout << "\r" << numFinished.load() << " / " << numToRender
+                  << ", " << numFailed.load() << " failed" << std::endl;
+
+        return numFailed.load();
+    }
+
+    String getFileNameFor (const ModalNoteSettings& note) const
+    {
+        return "n" + String (note.midiNote).paddedLeft ('0', 3)
+             + "_v" + String (roundToInt (note.velocity * 127.0f)).paddedLeft ('0', 3)
+             + "_s" + String (note.stiffness, 3)
+             + "_k" + String (note.pluckPos, 3)
+             + "_p" + String (note.pickupPos, 3)
+             + "_t" + String (getStartSample())
+             + (options.useFlac ? ".flac" : ".wav");
+    }
+
+    /** Returns how far into each note the files start, in samples. */
+    int64 getStartSample() const noexcept       { return (int64) (options.startSeconds * options.sampleRate); }
+
+private:
+    //==============================================================================
+    struct RenderJob final : public ThreadPoolJob
+    {
+        RenderJob (SampleLibraryExporter& ownerIn, const ModalNoteSettings& noteIn)
+            : ThreadPoolJob ("render"), owner (ownerIn), note (noteIn) {}
+
+        JobStatus runJob() override
+        {
+            if (owner.renderToFile (note))
+                owner.numFinished++;
+            else
+                owner.numFailed++;
+
+            return jobHasFinished;
+        }
+
+        SampleLibraryExporter& owner;
+        ModalNoteSettings note;
+    };
+
+    bool renderToFile (const ModalNoteSettings& note)
+    {
+        auto fileName = getFileNameFor (note);
+        auto target = options.outputFolder.getChildFile (fileName);
+        auto partial = target.withFileExtension (target.getFileExtension() + ".partial");
+        partial.deleteFile();
+
+        std::unique_ptr<AudioFormat> format;
+
+        if (options.useFlac)
+            format = std::make_unique<FlacAudioFormat>();
+        else
+            format = std::make_unique<WavAudioFormat>();
+
+        auto stream = std::make_unique<FileOutputStream> (partial);
+
+        if (stream->failedToOpen())
+            return false;
+
+        std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (stream.get(), options.sampleRate,
+                                                                           (unsigned int) options.numChannels,
+                                                                           options.bitsPerSample, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        stream.release(); // the writer owns the stream now
+
+        OfflineModalRenderer renderer (options.sampleRate, options.numChannels);
+
+        auto numSamples = renderer.renderUntilSilent (note, options.silenceThresholdDb, options.maxSecondsPerNote,
+                                                      [&writer] (const AudioBuffer<float>& block, int numInBlock)
+                                                      {
+                                                          return writer->writeFromAudioSampleBuffer (block, 0, numInBlock);
+                                                      },
+                                                      getStartSample());
+        writer.reset();
+
+        if (numSamples < 0 || ! partial.moveFileTo (target))
+        {
+            partial.deleteFile();
+            return false;
+        }
+
+        appendToManifest (fileName, numSamples);
+        return true;
+    }
+
+    //==============================================================================
+    File getManifestFile() const        { return options.outputFolder.getChildFile ("manifest.txt"); }
+
+    std::set<String> loadManifest() const
+    {
+        std::set<String> names;
+        StringArray lines;
+        lines.addLines (getManifestFile().loadFileAsString());
+
+        for (auto& line : lines)
+        {
+            auto name = line.upToFirstOccurrenceOf ("\t", false, false).trim();
+
+            if (name.isNotEmpty() && options.outputFolder.getChildFile (name).existsAsFile())
+                names.insert (name);
+        }
+
+        return names;
+    }
+
+    void appendToManifest (const String& fileName, int numSamples)
+    {
+        const ScopedLock sl (manifestLock);
+
+        FileOutputStream out (getManifestFile());
+
+        if (out.openedOk())
+        {
+            out << fileName << "\t" << numSamples << "\t" << getStartSample() << newLine;
+            out.flush();
+        }
+    }
+
+    //==============================================================================
+    Options options;
+    std::vector<ModalNoteSettings> allNotes;
+
+    CriticalSection manifestLock;
+    std::atomic<int> numFinished { 0 }, numFailed { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleLibraryExporter)
+};
@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    Hands immutable objects from the message thread to the audio thread
+    without locking or freeing anything on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Publishes a new version of some immutable object by swapping an atomic
+    pointer, so the audio thread can always pick up the latest one with a
+    single load.
+
+    Versions that have been replaced are kept alive until the audio thread
+    has finished at least one block since the swap, at which point it can't
+    still be holding on to them. The audio thread reports this by calling
+    audioBlockFinished() at the end of every block, and the old versions are
+    then deleted by collectGarbage() on some other thread.
+*/
+template <typename ObjectType>
+class SnapshotPublisher
+{
+public:
+    SnapshotPublisher() = default;
+
+    ~SnapshotPublisher()
+    {
+        delete current.exchange (nullptr);
+    }
+
+    /** Makes a new version visible to the audio thread. This may be called
+        from any thread except the audio thread.
+    */
+    void publish (std::unique_ptr<ObjectType> newVersion)
+    {
+        const ScopedLock sl (lock);
+
+        if (auto* previous = current.exchange (newVersion.release()))
+            retired.push_back ({ std::unique_ptr<ObjectType> (previous), audioBlocksFinished.load() });
+
+        collectGarbage();
+    }
+
+    /** Returns the latest version. The pointer is only safe to use until the
+        end of the current audio block.
+    */
+    const ObjectType* get() const noexcept          { return current.load(); }
+
+    /** Must be called by the audio thread at the end of each block, once it
+        has stopped using anything it got from get().
+    */
+    void audioBlockFinished() noexcept              { ++audioBlocksFinished; }
+
+    /** Tells the publisher whether an audio thread is running. While it isn't,
+        replaced versions can be deleted straight away.
+    */
+    void setAudioRunning (bool isRunning) noexcept
+    {
+        audioRunning = isRunning;
+        ++audioBlocksFinished;
+    }
+
+    /** Deletes any replaced versions that the audio thread can no longer be
+        using. Call this regularly from the message thread.
+    */
+    void collectGarbage()
+    {
+        const ScopedLock sl (lock);
+        auto blocksFinished = audioBlocksFinished.load();
+        auto running = audioRunning.load();
+
+        retired.erase (std::remove_if (retired.begin(), retired.end(),
+                                       [=] (const Retired& r) { return ! running || blocksFinished > r.blocksFinishedWhenRetired; }),
+                       retired.end());
+    }
+
+    /** Returns the number of replaced versions still waiting to be deleted. */
+    int getNumPendingDeletion() const
+    {
+        const ScopedLock sl (lock);
+        return (int) retired.size();
+    }
+
+private:
+    struct Retired
+    {
+        std::unique_ptr<ObjectType> object;
+        uint64 blocksFinishedWhenRetired;
+    };
+
+    std::atomic<ObjectType*> current { nullptr };
+    std::atomic<uint64> audioBlocksFinished { 0 };
+    std::atomic<bool> audioRunning { false };
+
+    CriticalSection lock;
+    std::vector<Retired> retired;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SnapshotPublisher)
+};
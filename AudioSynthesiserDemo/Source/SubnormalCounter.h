@@ -0,0 +1,73 @@
+/*
+  ==============================================================================
+
+    Debug-build counters for subnormal numbers showing up in the render path.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/** Counts how many subnormal values have been seen at each stage of the synth.
+
+    Subnormals are very slow to process on x86, and they tend to appear in
+    exactly the long decaying tails that can't be heard any more. The checks
+    are only made in debug builds; in release builds nothing is counted.
+
+    With flush-to-zero on, subnormals are gone before they can be counted, so
+    these only find anything where it's off, which is in the "denormals"
+    benchmark's unprotected runs. The audio callback always runs with it on.
+*/
+struct SubnormalCounter
+{
+    enum Stage
+    {
+        modeAmplitudes,
+        voiceOutput,
+        numStages
+    };
+
+    template <typename FloatType>
+    static void check (Stage stage, const FloatType* values, int numValues) noexcept
+    {
+       #if JUCE_DEBUG
+        int64 numFound = 0;
+
+        for (int i = 0; i < numValues; ++i)
+            if (std::fpclassify (values[i]) == FP_SUBNORMAL)
+                ++numFound;
+
+        if (numFound > 0)
+            counts[stage].fetch_add (numFound, std::memory_order_relaxed);
+       #else
+        ignoreUnused (stage, values, numValues);
+       #endif
+    }
+
+    template <typename FloatType>
+    static void check (Stage stage, FloatType value) noexcept
+    {
+        check (stage, &value, 1);
+    }
+
+    static String getReport()
+    {
+        static const char* const stageNames[] = { "mode amplitudes", "voice output" };
+        StringArray lines;
+
+        for (int i = 0; i < numStages; ++i)
+            lines.add (String (stageNames[i]) + ": " + String (counts[i].load (std::memory_order_relaxed)));
+
+        return "Subnormals seen - " + lines.joinIntoString (", ");
+    }
+
+    static void reset() noexcept
+    {
+        for (auto& count : counts)
+            count = 0;
+    }
+
+private:
+    static inline std::atomic<int64> counts[numStages] {};
+};